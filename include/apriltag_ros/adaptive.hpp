@@ -0,0 +1,23 @@
+#pragma once
+
+#include "tag_detector.hpp"
+
+#include <vector>
+
+// Controller of the quad decimation, and optionally the number of threads, of
+// the detectors of an image stream. It holds the duration of the detection
+// within 'Settings::adaptive_budget' while keeping the smallest detected tag
+// large enough in the decimated image to be found in the next frame.
+struct AdaptiveDecimation
+{
+    // current values, zero until initialised from the detector parameters
+    float decimate = 0;
+    int threads = 0;
+
+    // Adapt to the detection of a frame, given its duration in seconds and the
+    // detected tags with corners at full resolution.
+    void update(const double duration, const Detections::Tags &tags, const Settings &settings);
+};
+
+// shortest edge in pixels of the detected tags, infinite without tags
+double min_edge(const Detections::Tags &tags);
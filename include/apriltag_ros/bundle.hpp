@@ -0,0 +1,44 @@
+#pragma once
+
+#include "intrinsics.hpp"
+#include "pose.hpp"
+
+#include <apriltag.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// rigid arrangement of tags of a family, e.g. a board
+struct Bundle
+{
+    // child frame name
+    std::string name;
+    const apriltag_family_t *family;
+    // pose of the frame of each member tag in the bundle frame
+    std::unordered_map<int, Pose, std::hash<int>, std::equal_to<int>, Eigen::aligned_allocator<std::pair<const int, Pose>>> members;
+};
+
+// Configure a bundle by the ids of its members and their poses in the
+// bundle frame, given as 7 values (x, y, z, qw, qx, qy, qz) per member.
+Bundle bundle_config(const std::string &name,
+                     const apriltag_family_t *tf,
+                     const std::vector<int64_t> &ids,
+                     const std::vector<double> &poses);
+
+// pose of the bundle in the camera frame
+struct BundleDetection
+{
+    const Bundle *bundle;
+    // number of detected members
+    size_t members;
+    Pose pose;
+};
+
+// Estimate the pose of a bundle from the corners of its detected members 'X'
+// in the bundle frame and their pixels 'x', starting from the best of the
+// 'initial' poses.
+Pose getBundlePose(const Poses &initial,
+                   const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                   const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                   const Mat3 &P,
+                   const int iterations);
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "adaptive.hpp"
+#include "intrinsics.hpp"
+#include "metrics.hpp"
+#include "tag_detector.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// image handed to the pool, with the header of the message it came from
+struct Frame
+{
+    // keeps 'data' alive until the frame has been processed
+    std::shared_ptr<const void> image;
+    std::string encoding;
+    const uint8_t *data;
+    int width;
+    int height;
+    int step;
+    std::shared_ptr<const Intrinsics> intrinsics;
+    // stamp in nanoseconds and frame id of the image
+    int64_t stamp;
+    std::string frame_id;
+    // index of the image stream, e.g. the camera
+    size_t stream;
+    // order of arrival within the stream, assigned by the pool
+    uint64_t seq;
+};
+
+// maximum number of distinct detector stages in the metrics
+static constexpr size_t nstages = 16;
+
+// durations and counters of the processed frames
+struct Metrics
+{
+    Histogram conversion;
+    Histogram detection;
+    // detector stages from 'timeprofile' by name, see 'stage'
+    std::array<Histogram, nstages> stages;
+    std::array<Histogram, npose_estimators> pose; // per estimator
+    Histogram publish; // duration of the callback
+    Histogram detections{1};
+    Histogram decimate{1}; // with 'Settings::adaptive'
+    Histogram scratch{1}; // scratch memory of the converted frames in bytes
+    std::atomic<uint64_t> frames_processed{0};
+    std::atomic<uint64_t> frames_dropped{0};
+    // Names of the first 'stages_named' histograms in 'stages' in the order
+    // of their first occurrence. Named histograms are never renamed.
+    std::array<std::string, nstages> stage_names;
+    std::atomic<size_t> stages_named{0};
+
+    // histogram of the stage 'name', null if all are taken by other names
+    Histogram *stage(const std::string &name);
+
+private:
+    std::mutex mutex_stages; // only between naming stages
+};
+
+// Pool of detectors, each processing one frame at a time in its own thread.
+// Frames of multiple image streams are handed over from the producers to the
+// next free detector via a single slot per stream that is either waited for
+// or overwritten. Free detectors take frames from the streams in turn. The
+// detections of a stream are passed to the callback in order of arrival of
+// its frames, which is not sorted by their stamps. The callback may run
+// concurrently for different streams.
+class DetectorPool
+{
+public:
+    typedef std::function<void(const Frame &, const Detections &)> Callback;
+
+    DetectorPool(std::shared_ptr<const DetectorConfig> config,
+                 const size_t size,
+                 const size_t streams,
+                 const bool drop_frames,
+                 Callback callback);
+
+    ~DetectorPool();
+
+    DetectorPool(const DetectorPool &) = delete;
+    DetectorPool &operator=(const DetectorPool &) = delete;
+
+    // Hand over the frame of stream 'frame->stream'. Waits until a detector
+    // took the previous frame of the stream, or replaces the previous frame
+    // with 'drop_frames'.
+    void push(std::unique_ptr<Frame> frame);
+
+    // Change the parameters of all detectors, starting from the current
+    // parameters. The detectors apply them before their next frame without
+    // waiting for frames in detection.
+    void configure(const std::function<void(DetectorParameters &)> &f);
+
+    Metrics &metrics();
+
+private:
+    const std::shared_ptr<const DetectorConfig> config;
+    const bool drop_frames;
+    const Callback callback;
+
+    // immutable parameters, replaced atomically by 'configure'
+    std::shared_ptr<const DetectorParameters> parameters;
+    std::mutex mutex_parameters; // only between concurrent 'configure'
+
+    struct Worker
+    {
+        explicit Worker(std::shared_ptr<const DetectorConfig> config)
+            : detector(std::move(config)) {}
+
+        TagDetector detector;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    struct Stream
+    {
+        explicit Stream(const TagFamilies &families)
+            : tracking(families) {}
+
+        std::atomic<Frame *> pending{nullptr};
+
+        // frames in detection, passed to the callback in order of arrival
+        std::mutex mutex_publish;
+        std::condition_variable cv_publish;
+        std::set<uint64_t> in_flight;
+        uint64_t seq_next = 0;
+
+        Tracking tracking;
+
+        std::mutex mutex_adaptive;
+        AdaptiveDecimation adaptive;
+    };
+    std::vector<std::unique_ptr<Stream>> streams;
+
+    std::mutex mutex_frame; // only for waiting on the slots
+    std::condition_variable cv_frame;
+    bool running;
+    size_t stream_next; // first stream to take a frame from
+
+    // take the next frame from the slots, with 'mutex_frame' held
+    Frame *take();
+
+    Metrics metric;
+
+    void work(Worker &worker);
+
+    void process(Worker &worker, const Frame &frame);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "pose.hpp"
+
+#include <Eigen/Core>
+#include <cstdint>
+
+// Constant velocity Kalman filter of a pose. The axes of the translation and
+// of the rotation vector are filtered independently with the same noise and
+// hence share the covariance of value and rate.
+struct PoseFilter
+{
+    // time of the last update in nanoseconds, negative before the first update
+    int64_t stamp = -1;
+    Eigen::Vector3d position;
+    Eigen::Vector3d velocity;
+    Eigen::Quaterniond rotation;
+    Eigen::Vector3d angular_velocity;
+    Eigen::Matrix2d covariance_translation;
+    Eigen::Matrix2d covariance_rotation;
+
+    // true if the filter was updated within 'timeout' seconds before 'time'
+    bool active(const int64_t time, const double timeout) const;
+
+    // pose extrapolated to 'time'
+    Pose predict(const int64_t time) const;
+
+    // Update with the pose measured at 'time' and return the filtered pose.
+    // The filter is reset to the measurement if it is not active.
+    // 'process_noise' is the spectral density of the acceleration and
+    // 'measurement_noise' the variance of the measured position and rotation.
+    Pose update(const Pose &measurement,
+                const int64_t time,
+                const double timeout,
+                const double process_noise,
+                const double measurement_noise);
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Values by tag id, created on the first use of an id. The ids index a dense
+// table of pointers that grows to the largest id in use, such that large
+// families only store the values of the used ids. Values are never moved.
+template <typename T>
+class IdTable
+{
+public:
+    IdTable() = default;
+    IdTable(IdTable &&) = default;
+
+    IdTable(const IdTable &) = delete;
+    IdTable &operator=(const IdTable &) = delete;
+
+    // the value of 'id', null before its first use
+    const T *find(const int id) const
+    {
+        return size_t(id) < index.size() ? index[id] : nullptr;
+    }
+
+    // the value of 'id', default-constructed on its first use
+    T &get(const int id)
+    {
+        if (size_t(id) >= index.size())
+            index.resize(size_t(id) + 1, nullptr);
+        if (!index[id])
+        {
+            values.emplace_back();
+            index[id] = &values.back();
+        }
+        return *index[id];
+    }
+
+private:
+    std::vector<T *> index;
+    std::deque<T, Eigen::aligned_allocator<T>> values;
+};
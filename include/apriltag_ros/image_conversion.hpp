@@ -0,0 +1,32 @@
+#pragma once
+
+#include <apriltag.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// true if images with this encoding can be converted by 'convert_mono8'
+bool can_convert_mono8(const std::string &encoding);
+
+// Bytes per pixel of images that 'convert_mono8' can convert, with planar YUV
+// the bytes per pixel of the luminance plane.
+int bytes_per_pixel(const std::string &encoding);
+
+// True if 'size' bytes hold 'height' rows of 'step' bytes with 'width' pixels
+// each, which 'convert_mono8' requires to stay in bounds.
+bool valid_image(const std::string &encoding,
+                 const uint32_t width,
+                 const uint32_t height,
+                 const uint32_t step,
+                 const size_t size);
+
+// Provide an 8 bit monochrome view of the image without intermediate allocations.
+// 'mono8' and planar YUV images are wrapped without copying, the luminance of
+// packed YUV, Bayer and RGB images is extracted into 'buffer', which keeps its
+// capacity for the next frames.
+image_u8_t convert_mono8(const std::string &encoding,
+                         const uint8_t *data,
+                         const int width,
+                         const int height,
+                         const int step,
+                         std::vector<uint8_t> &buffer);
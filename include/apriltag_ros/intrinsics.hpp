@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> Mat3;
+
+// camera intrinsics and quantities derived from them
+struct Intrinsics
+{
+    // left 3x3 block of the projection matrix and its inverse, or the camera
+    // matrix of unrectified images
+    Mat3 P;
+    Mat3 Pinv;
+    // distortion coefficients (k1, k2, p1, p2, k3, k4, k5, k6) of the images
+    // with camera matrix 'P', all zero for rectified images
+    std::array<double, 8> d;
+    bool distorted;
+};
+
+// Transform the pixels of all points at once from the distorted image to the
+// undistorted image with the same camera matrix, and back.
+void undistort(Eigen::Ref<Eigen::Matrix2Xd> pixels, const Intrinsics &intrinsics);
+
+void distort(Eigen::Ref<Eigen::Matrix2Xd> pixels, const Intrinsics &intrinsics);
+
+// Cache of the camera intrinsics. The derived quantities are only recomputed
+// when the hash of the projection matrix 'p', camera matrix 'k' or
+// distortion 'd' changes. With 'undistort', the intrinsics describe the
+// unrectified images by 'k' and 'd' in the plumb bob or rational polynomial
+// model, otherwise the rectified images by 'p'.
+class IntrinsicsCache
+{
+public:
+    std::shared_ptr<const Intrinsics>
+    get(const std::array<double, 12> &p,
+        const std::array<double, 9> &k,
+        const std::vector<double> &d,
+        const bool undistort = false);
+
+private:
+    uint64_t hash = 0;
+    std::shared_ptr<const Intrinsics> intrinsics;
+};
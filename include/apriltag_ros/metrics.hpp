@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free accumulator of non-negative values in logarithmic bins with a
+// relative width of about 19%. Values can be added concurrently from multiple
+// threads while another thread periodically collects and resets them.
+class Histogram
+{
+public:
+    struct Summary
+    {
+        uint64_t count;
+        double min;
+        double mean;
+        double p99;
+        double max;
+    };
+
+    // 'resolution' is the upper bound of the first bin
+    explicit Histogram(const double resolution = 1e-6);
+
+    void add(const double value);
+
+    // summary of the values added since the last call
+    Summary collect();
+
+private:
+    static constexpr size_t nbins = 128;
+    static constexpr double bins_per_octave = 4;
+
+    const double resolution;
+    std::array<std::atomic<uint64_t>, nbins> bins;
+    std::atomic<uint64_t> count;
+    std::atomic<double> sum;
+    std::atomic<double> min;
+    std::atomic<double> max;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "intrinsics.hpp"
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <apriltag.h>
+#include <array>
+#include <string>
+#include <vector>
+
+// pose of the tag frame in the camera frame
+struct Pose
+{
+    Eigen::Vector3d translation;
+    Eigen::Quaterniond rotation;
+};
+
+// containers of fixed-size Eigen types need an aligned allocator before C++17
+typedef std::vector<Pose, Eigen::aligned_allocator<Pose>> Poses;
+
+enum class PoseEstimator
+{
+    // closed-form decomposition of the homography
+    Homography,
+    // orthogonal iteration of the library ('estimate_tag_pose')
+    OrthogonalIteration,
+    // Levenberg-Marquardt minimisation of the reprojection error
+    LevenbergMarquardt,
+};
+
+static constexpr size_t npose_estimators = 3;
+
+// estimator by name: homography, orthogonal_iteration or lm
+PoseEstimator pose_estimator(const std::string &name);
+
+const char *pose_estimator_name(const PoseEstimator estimator);
+
+// The poses below have their x and y axis along the x and y axis of the
+// homography, i.e. the z axis points into the tag.
+
+// decompose the homography 'H' of a tag with edge length 'size'
+Pose getPose(const matd_t &H,
+             const Mat3 &Pinv,
+             const double size);
+
+// orthogonal iteration starting from the homography of the detection
+Pose getPoseOrthogonalIteration(apriltag_detection_t *det,
+                                const Mat3 &P,
+                                const double size);
+
+// corners of a tag with edge length 'size' in the order of the detection, in
+// the tag frame rotated by 'rotate_z_up' if 'z_up' is set
+Eigen::Matrix<double, 3, 4> tag_corners(const double size, const bool z_up = false);
+
+// homography from the tag coordinates (-1, 1), (1, 1), (1, -1), (-1, -1) to
+// the pixels 'p' of the corners
+Mat3 tag_homography(const double p[4][2]);
+
+// pixels (x0, y0, ..., x3, y3) of the corners of a tag at 'pose'
+std::array<double, 8> project_corners(const Pose &pose, const double size, const bool z_up, const Mat3 &P);
+
+// Refine 'pose' with at most 'iterations' Levenberg-Marquardt steps, minimising
+// the reprojection error of the points 'X' in the frame of the pose to the
+// pixels 'x'.
+void refinePose(Pose &pose,
+                const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                const Mat3 &P,
+                const int iterations);
+
+// refine the pose of a tag by the corners 'p' of its detection
+void refinePose(Pose &pose,
+                const double p[4][2],
+                const Mat3 &P,
+                const double size,
+                const int iterations);
+
+// sum of the squared reprojection errors of the points 'X' to the pixels 'x'
+double reprojection_error(const Pose &pose,
+                          const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                          const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                          const Mat3 &P);
+
+double reprojection_error(const Pose &pose,
+                          const double p[4][2],
+                          const Mat3 &P,
+                          const double size);
+
+// rotate by half rotation about x-axis to let the z axis point out of the tag,
+// which also reverts the rotation
+Pose rotate_z_up(const Pose &pose);
+
+// composition and inverse of rigid transformations
+Pose operator*(const Pose &a, const Pose &b);
+
+Pose inverse(const Pose &pose);
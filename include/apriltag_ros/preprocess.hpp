@@ -0,0 +1,36 @@
+#pragma once
+
+#include <apriltag.h>
+#include <memory>
+
+// Decimation and blur of images for the quad detection on the GPU, only
+// available if built with OpenCV CUDA support ('APRILTAG_ROS_CUDA').
+class GpuPreprocessor
+{
+public:
+    // true if built with CUDA support and a device is present
+    static bool available();
+
+    GpuPreprocessor();
+
+    ~GpuPreprocessor();
+
+    GpuPreprocessor(const GpuPreprocessor &) = delete;
+    GpuPreprocessor &operator=(const GpuPreprocessor &) = delete;
+
+    // Decimate the image by 'decimation_factor(decimate)' and blur it by a
+    // positive 'sigma' as the library would for the quad detection. The
+    // returned view remains valid until the next call.
+    image_u8_t process(const image_u8_t &im, const float decimate, const float sigma);
+
+private:
+    struct Buffers;
+    std::unique_ptr<Buffers> buffers;
+};
+
+// the library decimates by 1.5 or by the integer part of 'quad_decimate'
+float decimation_factor(const float decimate);
+
+// transform the corners, centre and homography of detections in an image
+// decimated by 'factor' to the original image
+void rescale(zarray_t *detections, const float factor);
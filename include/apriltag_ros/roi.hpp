@@ -0,0 +1,33 @@
+#pragma once
+
+#include <apriltag.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// axis-aligned region of interest in pixel coordinates
+struct Rect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// bounding box of the 4 tag corners (x0, y0, ..., x3, y3), enlarged on each
+// side by 'padding' times its size and clipped to the image
+Rect bounding_box(const std::array<double, 8> &corners, const double padding, const int width, const int height);
+
+// intersection of the region with the image
+Rect clip(const Rect &rect, const int width, const int height);
+
+// Regions from a flat list of x, y, width and height of each region with
+// overlapping regions merged.
+std::vector<Rect> regions(const std::vector<int64_t> &rects);
+
+// replace overlapping regions by their union
+void merge_overlapping(std::vector<Rect> &rects);
+
+// detect tags in the sub-image 'roi' of 'im' and transform the corners,
+// centre and homography of the detections to full image coordinates
+zarray_t *detect_region(apriltag_detector_t *td, const image_u8_t &im, const Rect &roi);
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "bundle.hpp"
+#include "filter.hpp"
+#include "id_table.hpp"
+#include "intrinsics.hpp"
+#include "pose.hpp"
+#include "preprocess.hpp"
+#include "roi.hpp"
+#include "tag_families.hpp"
+
+#include <Eigen/StdVector>
+#include <apriltag.h>
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// configuration of a tag id
+struct TagConfig
+{
+    // detect the tag, all tags are detected without a list of frames
+    bool enabled;
+    // index of the child frame name in 'TagConfigs::frames', negative for
+    // the default name of an id without a stored name
+    int frame;
+    // edge size
+    double size;
+    // index of the bundle of member tags in 'DetectorConfig::bundles',
+    // negative for tags that are not a member
+    int bundle;
+};
+
+// Configuration of the tags of a family in a dense table by id. Families with
+// up to 'max_dense' codes store all ids and the default child frame names
+// "<family>:<id>". Larger families only store the ids up to the largest
+// configured id, the other ids share 'other' and are named by the detector on
+// their first detection.
+struct TagConfigs
+{
+    static constexpr uint32_t max_dense = 4096;
+
+    std::vector<TagConfig> ids;
+    TagConfig other;
+    // default and configured child frame names
+    std::vector<std::string> frames;
+
+    const TagConfig &get(const int id) const
+    {
+        return size_t(id) < ids.size() ? ids[id] : other;
+    }
+
+    // configure 'id', starting from the configuration of the other ids
+    TagConfig &add(const int id)
+    {
+        if (size_t(id) >= ids.size())
+            ids.resize(size_t(id) + 1, other);
+        return ids[id];
+    }
+};
+
+// Configure the tags of family 'tf' by optional frame names and sizes per id.
+// Tags without a specific size have the edge size 'size'. With frame names,
+// only the listed tags are enabled.
+TagConfigs tag_config(const apriltag_family_t *tf,
+                      const std::vector<int64_t> &ids,
+                      const std::vector<std::string> &frames,
+                      const std::vector<double> &sizes,
+                      const double size);
+
+// Settings that can be changed while detecting. A detector uses a single
+// snapshot of the settings per frame, see 'DetectorConfig::settings'.
+struct Settings
+{
+    // reject detections with more corrected bits than allowed
+    int max_hamming = 0;
+    bool z_up = true;
+    PoseEstimator estimator = PoseEstimator::Homography;
+    // maximum number of Levenberg-Marquardt iterations
+    int pose_iterations = 10;
+    // print the 'timeprofile' of the detector to stdout
+    bool profile = false;
+    // search for tags in regions around the tags of the previous frame
+    bool tracking = false;
+    double tracking_padding = 0.5;
+    int tracking_interval = 30;
+    // filter the tag poses over time, see 'PoseFilter'
+    bool filter = false;
+    double filter_timeout = 0.5;
+    double filter_process_noise = 0.1;
+    double filter_measurement_noise = 1e-4;
+    // adapt the decimation to a budget of the detection in seconds, see
+    // 'AdaptiveDecimation'
+    bool adaptive = false;
+    double adaptive_budget = 0.033;
+    double adaptive_hysteresis = 0.2;
+    double adaptive_min_decimate = 1.0;
+    double adaptive_max_decimate = 4.0;
+    // minimum edge length of the tags in the decimated image in pixels
+    double adaptive_min_size = 12.0;
+    // maximum number of threads, 0 to keep the configured number
+    int adaptive_threads = 0;
+    // decimate and blur full frames on the GPU, if available
+    bool gpu = false;
+    // Replace full-frame searches by a coarse pass with 'pyramid_decimate'
+    // for large tags and a fine pass in the tiles without large tags.
+    bool pyramid = false;
+    double pyramid_decimate = 4.0;
+    // size and overlap of the tiles of the fine pass in pixels
+    int pyramid_tile = 512;
+    int pyramid_overlap = 48;
+};
+
+// parameters of the apriltag detector, see 'struct apriltag_detector'
+struct DetectorParameters
+{
+    int nthreads;
+    float quad_decimate;
+    float quad_sigma;
+    bool refine_edges;
+    double decode_sharpening;
+    bool debug;
+};
+
+// the defaults of the library
+DetectorParameters default_parameters();
+
+// configuration shared by all detectors
+struct DetectorConfig
+{
+    explicit DetectorConfig(const std::vector<std::string> &names)
+        : families(names) {}
+
+    TagFamilies families;
+    // tags per family in the order of 'families'
+    std::vector<TagConfigs> tags;
+    std::vector<Bundle> bundles;
+    // static regions of interest without overlap, the full image if empty
+    std::vector<Rect> regions;
+
+    // the latest settings, which never change while in use
+    std::shared_ptr<const Settings> settings() const;
+
+    // Modify a copy of the latest settings by 'f' and replace them
+    // atomically, such that frames in detection keep their snapshot.
+    void configure(const std::function<void(Settings &)> &f);
+
+    const TagConfig &tag(const apriltag_family_t *family, const int id) const
+    {
+        return tags[families.index(family)].get(id);
+    }
+
+private:
+    // immutable settings, replaced atomically by 'configure'
+    std::shared_ptr<const Settings> current = std::make_shared<Settings>();
+    std::mutex mutex_settings; // only between concurrent 'configure'
+};
+
+// tag detection with its pose in the camera frame
+struct Detection
+{
+    const apriltag_family_t *family;
+    int id;
+    int hamming;
+    float decision_margin;
+    std::array<double, 2> centre;
+    std::array<double, 8> corners;
+    // row-major homography from tag coordinates to pixels
+    std::array<double, 9> homography;
+    // child frame name and edge size from the configuration
+    const std::string *frame;
+    double size;
+    Pose pose;
+    // bundle of the tag, if it is a member
+    const Bundle *bundle;
+};
+
+// detections of a frame
+struct Detections
+{
+    typedef std::vector<Detection, Eigen::aligned_allocator<Detection>> Tags;
+    Tags tags;
+    std::vector<BundleDetection, Eigen::aligned_allocator<BundleDetection>> bundles;
+};
+
+// state of a tag in an image stream
+struct Track
+{
+    const apriltag_family_t *family;
+    int id;
+    // detected in the previous frame
+    bool previous = false;
+    // corners, size and measured pose in the previous frame
+    std::array<double, 8> corners;
+    double size;
+    Pose pose;
+    PoseFilter filter;
+};
+
+// Tags in the previous frames of an image stream, shared by the detectors
+// processing this stream. A track is created when its tag is detected for
+// the first time and kept for later detections.
+class Tracking
+{
+public:
+    explicit Tracking(const TagFamilies &families);
+
+    std::mutex mutex;
+    // tags detected in the previous frame
+    std::vector<Track *> previous;
+    int frames_tracked = 0;
+
+    // the track of a tag, null before its first detection
+    const Track *find(const apriltag_family_t *family, const int id) const;
+
+    // Keep the detections of the frame at 'stamp' for the next frame. With
+    // 'Settings::filter', their poses are replaced by the filtered poses.
+    void update(Detections::Tags &detections, const int64_t stamp, const Settings &settings);
+
+private:
+    const TagFamilies &families;
+    // tracks per family in the order of 'families' by id
+    std::vector<IdTable<Track>> tracks;
+};
+
+// duration of a detector stage from 'timeprofile'
+struct Stage
+{
+    std::string name;
+    double duration;
+};
+
+// durations of the last frame in seconds
+struct Timings
+{
+    double conversion;
+    double detection;
+    // Detector stages by name in the order of their first stamp, summed over
+    // all searched regions. The stages depend on the parameters of the frame,
+    // e.g. "decimate" is only stamped with a decimation.
+    std::vector<Stage> stages;
+    double pose;
+    PoseEstimator estimator;
+};
+
+// A single apriltag detector processing one image at a time, independent of
+// any middleware.
+class TagDetector
+{
+public:
+    explicit TagDetector(std::shared_ptr<const DetectorConfig> config);
+
+    ~TagDetector();
+
+    TagDetector(const TagDetector &) = delete;
+    TagDetector &operator=(const TagDetector &) = delete;
+
+    // Set the parameters of the detector for the next frames. Must not be
+    // called concurrently with 'detect', e.g. only from the detecting thread.
+    // Without 'settings', each frame uses the latest settings of the
+    // configuration at its start.
+    void configure(const DetectorParameters &parameters, std::shared_ptr<const Settings> settings = nullptr);
+
+    // Detect tags in an image with any encoding supported by 'convert_mono8'
+    // and estimate their pose and the pose of the bundles. With 'tracking',
+    // only the regions around the tags of the previous frame, or their
+    // predicted regions at 'stamp' with 'Settings::filter', are searched.
+    // With distorted 'intrinsics', the poses are estimated from the
+    // undistorted corners. The detections remain valid until the next call.
+    Detections &detect(const std::string &encoding,
+                       const uint8_t *data,
+                       const int width,
+                       const int height,
+                       const int step,
+                       const Intrinsics &intrinsics,
+                       Tracking *tracking = nullptr,
+                       const int64_t stamp = 0);
+
+    Detections &detect(const image_u8_t &im,
+                       const Intrinsics &intrinsics,
+                       Tracking *tracking = nullptr,
+                       const int64_t stamp = 0);
+
+    const Timings &timings() const;
+
+    // bytes of the converted image of the last frame, 0 for wrapped images
+    size_t scratch() const;
+
+private:
+    const std::shared_ptr<const DetectorConfig> config;
+    apriltag_detector_t *const td;
+
+    std::shared_ptr<const Settings> configured; // by 'configure'
+    std::shared_ptr<const Settings> snapshot; // of the current frame
+
+    // default child frame names of the ids without a stored name, per family
+    // in the order of 'DetectorConfig::families'
+    std::vector<IdTable<std::string>> frames;
+
+    // buffers reused across frames
+    std::vector<uint8_t> converted; // luminance of the converted image
+    size_t nconverted = 0;
+    std::vector<Rect> rois; // around the tracked tags
+    std::vector<const Track *> expected;
+    std::vector<zarray_t *> results;
+    std::vector<apriltag_detection_t *> dets;
+    Detections detections;
+    Eigen::Matrix2Xd undistorted; // corners of all detections
+    // corners of the bundle members in the bundle frame and in the image
+    Eigen::Matrix3Xd bundle_points;
+    Eigen::Matrix2Xd bundle_pixels;
+    Poses bundle_poses;
+
+    Timings timing;
+
+    // created on first use with 'Settings::gpu'
+    std::unique_ptr<GpuPreprocessor> gpu;
+
+    // pose estimation of the detections in the range [begin, end)
+    struct PoseTask
+    {
+        TagDetector *detector;
+        const Intrinsics *intrinsics;
+        Tracking *tracking;
+        PoseEstimator estimator;
+        bool z_up;
+        int iterations;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<PoseTask> tasks;
+    static constexpr size_t min_detections_per_task = 8;
+
+    // task of the library worker pool
+    static void estimate_poses(void *task);
+
+    // detect in the monochrome image 'im'
+    void detect_image(const image_u8_t &im, const Intrinsics &intrinsics, Tracking *tracking, const int64_t stamp);
+
+    // detect tags in the full image
+    zarray_t *detect_frame(const image_u8_t &im);
+
+    // detect tags in 'area' by 'Settings::pyramid'
+    void detect_pyramid(const image_u8_t &im, const Rect &area);
+    std::vector<Rect> covered; // by the large tags of the coarse pass
+    std::vector<Rect> overlapping; // covered parts of a tile
+    std::vector<int> xs, ys; // cell boundaries of a tile
+
+    // With 'deduplicate', only the detection with the largest margin of the
+    // same tag in overlapping regions is accepted.
+    void accept(const bool deduplicate = false);
+
+    void estimate_bundles(const Intrinsics &intrinsics);
+
+    void profile_stages();
+};
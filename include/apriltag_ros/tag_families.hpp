@@ -0,0 +1,44 @@
+#pragma once
+
+#include <apriltag.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Tag families shared by multiple detectors. Each family and its
+// quick-decode table is built once per process by a detector owned by a
+// registry entry, which is shared by reference count across all instances of
+// this class, e.g. the nodes of a component container. Detectors only
+// reference the families.
+class TagFamilies
+{
+public:
+    explicit TagFamilies(const std::vector<std::string> &names);
+
+    ~TagFamilies();
+
+    TagFamilies(const TagFamilies &) = delete;
+    TagFamilies &operator=(const TagFamilies &) = delete;
+
+    // register all families on the detector
+    void add(apriltag_detector_t *td) const;
+
+    // unregister all families before the detector is destroyed
+    void remove(apriltag_detector_t *td) const;
+
+    const std::vector<apriltag_family_t *> &get() const;
+
+    // position of a registered family in 'get()'
+    size_t index(const apriltag_family_t *family) const;
+
+    // number of families that were built by this instance, the others were
+    // shared with existing instances
+    size_t created() const;
+
+private:
+    struct Family;
+    std::vector<std::shared_ptr<const Family>> shared;
+    std::vector<apriltag_family_t *> families;
+    size_t ncreated;
+};
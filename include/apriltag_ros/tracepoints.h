@@ -0,0 +1,36 @@
+// LTTng-UST tracepoint provider, included via 'tracing.hpp'. This header is
+// read multiple times by the LTTng macros and hence has no include guard.
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER apriltag_ros
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "apriltag_ros/tracepoints.h"
+
+#if !defined(APRILTAG_ROS_TRACEPOINTS_H) || defined(TRACEPOINT_HEADER_MULTI_READ)
+#define APRILTAG_ROS_TRACEPOINTS_H
+
+#include <lttng/tracepoint.h>
+#include <stdint.h>
+
+TRACEPOINT_EVENT_CLASS(
+    apriltag_ros, frame,
+    TP_ARGS(int64_t, stamp, const char *, frame_id),
+    TP_FIELDS(
+        ctf_integer(int64_t, stamp, stamp)
+        ctf_string(frame_id, frame_id)))
+
+// entry of the image callback
+TRACEPOINT_EVENT_INSTANCE(apriltag_ros, frame, callback, TP_ARGS(int64_t, stamp, const char *, frame_id))
+// image converted to 8 bit monochrome
+TRACEPOINT_EVENT_INSTANCE(apriltag_ros, frame, conversion, TP_ARGS(int64_t, stamp, const char *, frame_id))
+// tags detected
+TRACEPOINT_EVENT_INSTANCE(apriltag_ros, frame, detection, TP_ARGS(int64_t, stamp, const char *, frame_id))
+// tag and bundle poses estimated
+TRACEPOINT_EVENT_INSTANCE(apriltag_ros, frame, pose, TP_ARGS(int64_t, stamp, const char *, frame_id))
+// detections, poses and transforms published
+TRACEPOINT_EVENT_INSTANCE(apriltag_ros, frame, publish, TP_ARGS(int64_t, stamp, const char *, frame_id))
+
+#endif
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,38 @@
+#pragma once
+
+// LTTng tracepoints at the stage boundaries of a frame, tagged with the stamp
+// of the image in nanoseconds and its frame id. Without APRILTAG_ROS_TRACING,
+// the macros compile to nothing.
+//
+// APRILTAG_ROS_TRACE(event, stamp, frame_id)  emits 'event' of a frame
+// APRILTAG_ROS_TRACE_FRAME(stamp, frame_id)   sets the frame of this thread
+// APRILTAG_ROS_TRACE_STAGE(event)             emits 'event' of that frame
+//
+// events: callback, conversion, detection, pose, publish
+
+#ifdef APRILTAG_ROS_TRACING
+
+#include "apriltag_ros/tracepoints.h"
+
+#include <cstdint>
+
+// frame processed by the current thread
+struct TraceFrame
+{
+    int64_t stamp;
+    const char *frame_id;
+};
+
+extern thread_local TraceFrame trace_frame;
+
+#define APRILTAG_ROS_TRACE(event, stamp, frame_id) tracepoint(apriltag_ros, event, stamp, frame_id)
+#define APRILTAG_ROS_TRACE_FRAME(stamp, frame_id) (trace_frame = TraceFrame{stamp, frame_id})
+#define APRILTAG_ROS_TRACE_STAGE(event) tracepoint(apriltag_ros, event, trace_frame.stamp, trace_frame.frame_id)
+
+#else
+
+#define APRILTAG_ROS_TRACE(event, stamp, frame_id) ((void)0)
+#define APRILTAG_ROS_TRACE_FRAME(stamp, frame_id) ((void)0)
+#define APRILTAG_ROS_TRACE_STAGE(event) ((void)0)
+
+#endif
@@ -2,19 +2,42 @@
 #include <rclcpp/rclcpp.hpp>
 #include <sensor_msgs/msg/camera_info.hpp>
 #include <sensor_msgs/msg/image.hpp>
+#include <std_srvs/srv/trigger.hpp>
 #include <apriltag_msgs/msg/april_tag_detection.hpp>
 #include <apriltag_msgs/msg/april_tag_detection_array.hpp>
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <geometry_msgs/msg/pose_array.hpp>
+#include <tf2_ros/static_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <image_transport/camera_subscriber.hpp>
 #include <image_transport/image_transport.hpp>
 #include <cv_bridge/cv_bridge.h>
+#include <Eigen/StdVector>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
 #include <rclcpp_components/register_node_macro.hpp>
+#ifdef APRILTAG_ROS_LIFECYCLE
+#include <rclcpp_lifecycle/lifecycle_node.hpp>
+#endif
 
 // apriltag
 #include <apriltag.h>
-#include "tag_functions.hpp"
+#include "apriltag_ros/detector_pool.hpp"
+#include "apriltag_ros/id_table.hpp"
+#include "apriltag_ros/image_conversion.hpp"
+#include "apriltag_ros/intrinsics.hpp"
+#include "apriltag_ros/metrics.hpp"
+#include "apriltag_ros/pose.hpp"
+#include "apriltag_ros/preprocess.hpp"
+#include "apriltag_ros/roi.hpp"
+#include "apriltag_ros/tag_detector.hpp"
+#include "apriltag_ros/tracing.hpp"
 
-#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
 
 #define IF(N, V)                       \
     if (assign_check(parameter, N, V)) \
@@ -43,8 +66,6 @@ bool assign_check(const rclcpp::Parameter &parameter, const std::string &name, T
     return false;
 }
 
-typedef Eigen::Matrix<double, 3, 3, Eigen::RowMajor> Mat3;
-
 rcl_interfaces::msg::ParameterDescriptor
 descr(const std::string &description, const bool &read_only = false)
 {
@@ -56,250 +77,1129 @@ descr(const std::string &description, const bool &read_only = false)
     return descr;
 }
 
-void getPose(const matd_t &H,
-             const Mat3 &Pinv,
-             geometry_msgs::msg::Transform &t,
-             const double size,
-             const bool z_up)
+// bounding boxes of the connected non-zero regions of a mask image
+std::vector<Rect> mask_regions(const std::string &path)
 {
-    // compute extrinsic camera parameter
-    // https://dsp.stackexchange.com/a/2737/31703
-    // H = K * T  =>  T = K^(-1) * H
-    const Mat3 T = Pinv * Eigen::Map<const Mat3>(H.data);
-    Mat3 R;
-    R.col(0) = T.col(0).normalized();
-    R.col(1) = T.col(1).normalized();
-    R.col(2) = R.col(0).cross(R.col(1));
-
-    if (z_up)
-    {
-        // rotate by half rotation about x-axis
-        R.col(1) *= -1;
-        R.col(2) *= -1;
-    }
-
-    // the corner coordinates of the tag in the canonical frame are (+/-1, +/-1)
-    // hence the scale is half of the edge size
-    const Eigen::Vector3d tt = T.rightCols<1>() / ((T.col(0).norm() + T.col(0).norm()) / 2.0) * (size / 2.0);
-
-    const Eigen::Quaterniond q(R);
-
-    t.translation.x = tt.x();
-    t.translation.y = tt.y();
-    t.translation.z = tt.z();
-    t.rotation.w = q.w();
-    t.rotation.x = q.x();
-    t.rotation.y = q.y();
-    t.rotation.z = q.z();
+    const cv::Mat mask = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    if (mask.empty())
+    {
+        throw std::runtime_error("Cannot read mask image " + path + "!");
+    }
+
+    cv::Mat labels, stats, centroids;
+    const int n = cv::connectedComponentsWithStats(mask, labels, stats, centroids);
+
+    // label 0 is the background
+    std::vector<Rect> regions;
+    for (int i = 1; i < n; i++)
+    {
+        regions.push_back({stats.at<int>(i, cv::CC_STAT_LEFT), stats.at<int>(i, cv::CC_STAT_TOP), stats.at<int>(i, cv::CC_STAT_WIDTH), stats.at<int>(i, cv::CC_STAT_HEIGHT)});
+    }
+
+    return regions;
 }
 
-class AprilTagNode : public rclcpp::Node
+void toTransform(const Pose &pose, geometry_msgs::msg::Transform &t)
 {
-public:
-    AprilTagNode(const rclcpp::NodeOptions &options);
+    t.translation.x = pose.translation.x();
+    t.translation.y = pose.translation.y();
+    t.translation.z = pose.translation.z();
+    t.rotation.w = pose.rotation.w();
+    t.rotation.x = pose.rotation.x();
+    t.rotation.y = pose.rotation.y();
+    t.rotation.z = pose.rotation.z();
+}
 
-    ~AprilTagNode() override;
+void toPose(const Pose &pose, geometry_msgs::msg::Pose &p)
+{
+    p.position.x = pose.translation.x();
+    p.position.y = pose.translation.y();
+    p.position.z = pose.translation.z();
+    p.orientation.w = pose.rotation.w();
+    p.orientation.x = pose.rotation.x();
+    p.orientation.y = pose.rotation.y();
+    p.orientation.z = pose.rotation.z();
+}
+
+// publish policy of the transform of a tag
+struct TfPolicy
+{
+    // minimum period between transforms in seconds
+    double period;
+    // minimum change of the pose in meters and radians since the last transform
+    double translation;
+    double rotation;
+    // latch the transform on /tf_static once the pose has converged
+    bool latch;
+};
+
+// publish every detection by default
+const TfPolicy tf_default = {0, 0, 0, false};
+
+// publish policies of the tags of a family by id, up to the largest listed id
+struct TfPolicies
+{
+    std::vector<TfPolicy> ids;
+
+    const TfPolicy &get(const int id) const
+    {
+        return size_t(id) < ids.size() ? ids[id] : tf_default;
+    }
+};
+
+// Configure the transforms of the tags of family 'tf' by optional rates,
+// thresholds and latching per id.
+TfPolicies tf_config(const apriltag_family_t *tf,
+                     const std::vector<int64_t> &ids,
+                     const std::vector<double> &rates,
+                     const std::vector<double> &translations,
+                     const std::vector<double> &rotations,
+                     const std::vector<bool> &latches)
+{
+    const auto check = [&ids](const size_t size, const std::string &name) {
+        if (size && size != ids.size())
+        {
+            throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and " + name + " (" + std::to_string(size) + ") mismatch!");
+        }
+    };
+    check(rates.size(), "rates");
+    check(translations.size(), "translations");
+    check(rotations.size(), "rotations");
+    check(latches.size(), "static");
+
+    TfPolicies policies;
+    for (const int64_t id : ids)
+    {
+        if (id < 0 || id >= int64_t(tf->ncodes))
+        {
+            throw std::runtime_error("Tag id " + std::to_string(id) + " is not in family " + tf->name);
+        }
+        policies.ids.resize(std::max(policies.ids.size(), size_t(id) + 1), tf_default);
+    }
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        TfPolicy &policy = policies.ids[ids[i]];
+        if (!rates.empty())
+            policy.period = rates[i] > 0 ? 1 / rates[i] : 0;
+        if (!translations.empty())
+            policy.translation = translations[i];
+        if (!rotations.empty())
+            policy.rotation = rotations[i];
+        if (!latches.empty())
+            policy.latch = latches[i];
+        if (policy.latch && policy.translation <= 0 && policy.rotation <= 0)
+            throw std::runtime_error("Static tag " + std::to_string(ids[i]) + " requires a translation or rotation threshold!");
+    }
+
+    return policies;
+}
+
+const std::vector<std::string> detector_parameter_names = {
+    "detector.threads",
+    "detector.decimate",
+    "detector.blur",
+    "detector.refine",
+    "detector.sharpening",
+    "detector.debug",
+};
+
+// assign the "detector" parameters among 'parameters'
+void detector_parameters(const std::vector<rclcpp::Parameter> &parameters, DetectorParameters &detector)
+{
+    for (const rclcpp::Parameter &parameter : parameters)
+    {
+        assign_check(parameter, "detector.threads", detector.nthreads);
+        assign_check(parameter, "detector.decimate", detector.quad_decimate);
+        assign_check(parameter, "detector.blur", detector.quad_sigma);
+        assign_check(parameter, "detector.refine", detector.refine_edges);
+        assign_check(parameter, "detector.sharpening", detector.decode_sharpening);
+        assign_check(parameter, "detector.debug", detector.debug);
+    }
+}
+
+// transform of a tag in an image stream
+struct TfState
+{
+    // stamp and pose of the last transform, negative before the first
+    int64_t stamp = -1;
+    Pose pose;
+    // pose of the previous detection and the number of consecutive
+    // detections within the thresholds
+    Pose previous;
+    bool seen = false;
+    int stable = 0;
+    bool latched = false;
+};
+
+enum class TfAction
+{
+    Suppress,
+    Publish,
+    Latch
+};
+
+// decide how to publish the transform of a tag at 'pose' detected at 'stamp'
+TfAction tf_action(const TfPolicy &policy, TfState &state, const Pose &pose, const int64_t stamp, const int static_frames)
+{
+    // only the dimensions with a threshold are compared, without any threshold
+    // every pose has moved
+    const auto moved = [&policy](const Pose &a, const Pose &b) {
+        if (policy.translation <= 0 && policy.rotation <= 0)
+            return true;
+        return (policy.translation > 0 && (a.translation - b.translation).norm() > policy.translation) ||
+               (policy.rotation > 0 && a.rotation.angularDistance(b.rotation) > policy.rotation);
+    };
+
+    state.stable = (state.seen && !moved(pose, state.previous)) ? state.stable + 1 : 0;
+    state.previous = pose;
+    state.seen = true;
+
+    // restart after the stamps jumped back, e.g. with a looping recording
+    const bool first = state.stamp < 0 || stamp < state.stamp;
+
+    if (state.latched)
+    {
+        // only update the static transform if the pose changed
+        if (!first && !moved(pose, state.pose))
+            return TfAction::Suppress;
+    }
+    else if (!policy.latch || state.stable < static_frames)
+    {
+        if (!first && (stamp - state.stamp) * 1e-9 < policy.period)
+            return TfAction::Suppress;
+        if (!first && !moved(pose, state.pose))
+            return TfAction::Suppress;
+    }
+
+    state.latched = state.latched || (policy.latch && state.stable >= static_frames);
+    state.pose = pose;
+    state.stamp = stamp;
+    return state.latched ? TfAction::Latch : TfAction::Publish;
+}
+
+// detection of a ROS node, independent of its base class
+template <typename NodeT>
+class AprilTagNodeBase : public NodeT
+{
+protected:
+    explicit AprilTagNodeBase(const rclcpp::NodeOptions &options);
+
+    ~AprilTagNodeBase() override;
+
+    // create the detectors and subscribe to the images
+    void start();
+
+    // unsubscribe from the images and destroy the detectors with their
+    // threads and buffers
+    void stop();
 
 private:
-    const OnSetParametersCallbackHandle::SharedPtr cb_parameter;
-
-    apriltag_family_t *tf;
-    apriltag_detector_t *const td;
-
-    // parameter
-    std::mutex mutex;
-    double tag_edge_size;
-    std::atomic<int> max_hamming;
-    std::atomic<bool> profile;
-    std::unordered_map<int, std::string> tag_frames;
-    std::unordered_map<int, double> tag_sizes;
-    std::atomic<bool> z_up;
+    using NodeT::add_on_set_parameters_callback;
+    using NodeT::create_wall_timer;
+    using NodeT::declare_parameter;
+    using NodeT::get_clock;
+    using NodeT::get_fully_qualified_name;
+    using NodeT::get_logger;
+    using NodeT::get_parameters;
+    using NodeT::now;
+
+    const rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr cb_parameter;
+
+    // tag families, tags and settings shared by all detectors
+    std::shared_ptr<DetectorConfig> config;
+    std::unique_ptr<DetectorPool> pool;
+    size_t pool_size;
+    bool drop_frames;
+
+    // image subscriptions
+    std::string transport;
+    rmw_qos_profile_t qos;
+
     std::atomic<bool> enabled;
+    // maximum rate of detected frames per camera, 0 for all frames and
+    // negative for only the frames of single-shot requests
+    std::atomic<double> detection_rate;
+    // detect in unrectified images and undistort the corners
+    std::atomic<bool> undistort;
+
+    // published outputs
+    bool publish_detections;
+    bool publish_tf;
+    bool publish_poses;
+
+    // transform policies per family in the order of 'DetectorConfig::families'
+    std::vector<TfPolicies> tf_policies;
+    // consecutive stable detections before latching
+    int tf_static_frames;
 
-    std::function<void(apriltag_family_t *)> tf_destructor;
+    // image stream of a camera with its detections
+    struct Camera
+    {
+        std::string prefix; // namespace of the topics
+        image_transport::CameraSubscriber sub_cam;
+        rclcpp::Publisher<apriltag_msgs::msg::AprilTagDetectionArray>::SharedPtr pub_detections;
+        rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr pub_poses;
+        IntrinsicsCache intrinsics_cache;
+        // earliest stamp of the next frame to detect by 'detection_rate'
+        int64_t stamp_next = -1;
+        // single-shot requests, waiting for the next frame or for the
+        // detection of the frame at 'stamp'
+        rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr srv_detect;
+        struct Request
+        {
+            std::shared_ptr<rmw_request_id_t> id;
+            int64_t stamp;
+        };
+        std::mutex mutex_requests;
+        std::vector<std::shared_ptr<rmw_request_id_t>> requests_pending;
+        std::vector<Request> requests_detecting;
+        // buffers reused across frames
+        apriltag_msgs::msg::AprilTagDetectionArray msg_detections;
+        geometry_msgs::msg::PoseArray msg_poses;
+        std::vector<geometry_msgs::msg::TransformStamped> tfs;
+        std::vector<geometry_msgs::msg::TransformStamped> tfs_static;
+        // transforms per family by id, only for the detected tags
+        std::vector<IdTable<TfState>> tf_states;
+    };
+    std::vector<std::unique_ptr<Camera>> cameras;
+
+    // instrumentation, published as diagnostics
+    Histogram latency; // from image header stamp to publishing
+    rclcpp::Time time_diagnostics;
+    // frames with invalid images or calibrations
+    std::atomic<uint64_t> frames_rejected;
 
-    const image_transport::CameraSubscriber sub_cam;
-    const rclcpp::Publisher<apriltag_msgs::msg::AprilTagDetectionArray>::SharedPtr pub_detections;
     tf2_ros::TransformBroadcaster tf_broadcaster;
+    tf2_ros::StaticTransformBroadcaster tf_static_broadcaster;
+    std::atomic<uint64_t> tfs_published;
+    std::atomic<uint64_t> tfs_suppressed;
+    std::atomic<uint64_t> tfs_latched;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr pub_diagnostics;
+    rclcpp::TimerBase::SharedPtr timer_diagnostics;
+
+    rmw_qos_profile_t qos_profile();
+
+    void onCamera(Camera &camera, const size_t stream, const sensor_msgs::msg::Image::ConstSharedPtr &msg_img, const sensor_msgs::msg::CameraInfo::ConstSharedPtr &msg_ci);
+
+    void onDetections(const Frame &frame, const Detections &detections);
 
-    void onCamera(const sensor_msgs::msg::Image::ConstSharedPtr &msg_img, const sensor_msgs::msg::CameraInfo::ConstSharedPtr &msg_ci);
+    void onDetect(Camera &camera, const std::shared_ptr<rmw_request_id_t> &request);
+
+    // answer the requests of 'camera' with a failure
+    void reject(Camera &camera, const std::string &reason);
+
+    void onDiagnostics();
 
     rcl_interfaces::msg::SetParametersResult onParameter(const std::vector<rclcpp::Parameter> &parameters);
 };
 
+// node that starts detecting on construction
+class AprilTagNode : public AprilTagNodeBase<rclcpp::Node>
+{
+public:
+    explicit AprilTagNode(const rclcpp::NodeOptions &options)
+        : AprilTagNodeBase(options)
+    {
+        start();
+    }
+};
+
 RCLCPP_COMPONENTS_REGISTER_NODE(AprilTagNode)
 
-AprilTagNode::AprilTagNode(const rclcpp::NodeOptions &options)
-    : Node("apriltag", options),
+#ifdef APRILTAG_ROS_LIFECYCLE
+// Managed node that only subscribes to the images and holds the detectors
+// while it is active. The configuration, the tag families and the publishers
+// are kept while it is inactive.
+class AprilTagLifecycleNode : public AprilTagNodeBase<rclcpp_lifecycle::LifecycleNode>
+{
+public:
+    explicit AprilTagLifecycleNode(const rclcpp::NodeOptions &options)
+        : AprilTagNodeBase(options) {}
+
+private:
+    using CallbackReturn = rclcpp_lifecycle::node_interfaces::LifecycleNodeInterface::CallbackReturn;
+
+    CallbackReturn on_activate(const rclcpp_lifecycle::State &) override
+    {
+        start();
+        return CallbackReturn::SUCCESS;
+    }
+
+    CallbackReturn on_deactivate(const rclcpp_lifecycle::State &) override
+    {
+        stop();
+        return CallbackReturn::SUCCESS;
+    }
+
+    CallbackReturn on_shutdown(const rclcpp_lifecycle::State &) override
+    {
+        stop();
+        return CallbackReturn::SUCCESS;
+    }
+};
+
+RCLCPP_COMPONENTS_REGISTER_NODE(AprilTagLifecycleNode)
+#endif
+
+// image subscription of a node, lifecycle nodes are passed by their interfaces
+image_transport::CameraSubscriber
+camera_subscription(rclcpp::Node *node, const std::string &topic, const image_transport::CameraSubscriber::Callback &callback, const std::string &transport, const rmw_qos_profile_t &qos)
+{
+    return image_transport::create_camera_subscription(node, topic, callback, transport, qos);
+}
+
+#ifdef APRILTAG_ROS_LIFECYCLE
+image_transport::CameraSubscriber
+camera_subscription(rclcpp_lifecycle::LifecycleNode *node, const std::string &topic, const image_transport::CameraSubscriber::Callback &callback, const std::string &transport, const rmw_qos_profile_t &qos)
+{
+    return image_transport::create_camera_subscription(*node, topic, callback, transport, qos);
+}
+#endif
+
+template <typename NodeT>
+AprilTagNodeBase<NodeT>::AprilTagNodeBase(const rclcpp::NodeOptions &options)
+    : NodeT("apriltag", options),
       // parameter
-      cb_parameter(add_on_set_parameters_callback(std::bind(&AprilTagNode::onParameter, this, std::placeholders::_1))),
-      td(apriltag_detector_create()),
+      cb_parameter(add_on_set_parameters_callback(std::bind(&AprilTagNodeBase::onParameter, this, std::placeholders::_1))),
       enabled(false),
-      // topics
-      sub_cam(image_transport::create_camera_subscription(this, "image_rect", std::bind(&AprilTagNode::onCamera, this, std::placeholders::_1, std::placeholders::_2), declare_parameter("image_transport", "raw", descr({}, true)), rmw_qos_profile_default)),
-      pub_detections(create_publisher<apriltag_msgs::msg::AprilTagDetectionArray>("detections", rclcpp::QoS(1))),
-      tf_broadcaster(this)
+      detection_rate(0),
+      undistort(false),
+      frames_rejected(0),
+      tf_broadcaster(this),
+      tf_static_broadcaster(this),
+      tfs_published(0),
+      tfs_suppressed(0),
+      tfs_latched(0)
 {
+    const auto start = std::chrono::steady_clock::now();
+
     // read-only parameters
-    const std::string tag_family = declare_parameter("family", "36h11", descr("tag family", true));
-    tag_edge_size = declare_parameter("size", 1.0, descr("default tag size", true));
+    transport = declare_parameter("image_transport", "raw", descr({}, true));
+    qos = qos_profile();
+    const std::vector<std::string> namespaces = declare_parameter("cameras", std::vector<std::string>{}, descr("namespaces of the cameras, empty for a single camera", true));
+    rcl_interfaces::msg::ParameterDescriptor descr_family = descr("tag family or list of tag families", true);
+    descr_family.dynamic_typing = true;
+    const rclcpp::ParameterValue family = declare_parameter("family", rclcpp::ParameterValue(std::string("36h11")), descr_family);
+    const std::vector<std::string> tag_families = (family.get_type() == rclcpp::ParameterType::PARAMETER_STRING_ARRAY) ? family.get<std::vector<std::string>>() : std::vector<std::string>{family.get<std::string>()};
+    const double tag_edge_size = declare_parameter("size", 1.0, descr("default tag size", true));
+    const int npool = declare_parameter("pool_size", 1, descr("number of detectors processing frames in parallel, publishing in the order of arrival", true));
+    const std::string queue_policy = declare_parameter("queue.policy", "block", descr("wait for a free detector (block) or replace the waiting frame (latest)", true));
+
+    if (queue_policy != "block" && queue_policy != "latest")
+    {
+        throw std::runtime_error("Unsupported queue policy: " + queue_policy);
+    }
 
-    // get tag names, IDs and sizes
+    if (npool < 1)
+    {
+        throw std::runtime_error("Detector pool size (" + std::to_string(npool) + ") must be positive!");
+    }
+    pool_size = size_t(npool);
+    drop_frames = queue_policy == "latest";
+
+    std::shared_ptr<DetectorConfig> detector_config = std::make_shared<DetectorConfig>(tag_families);
+
+    // get tag names, IDs and sizes, used for families without specific configuration
     const auto ids = declare_parameter("tag.ids", std::vector<int64_t>{}, descr("tag ids", true));
     const auto frames = declare_parameter("tag.frames", std::vector<std::string>{}, descr("tag frame names per id", true));
     const auto sizes = declare_parameter("tag.sizes", std::vector<double>{}, descr("tag sizes per id", true));
+    const auto rates = declare_parameter("tag.rates", std::vector<double>{}, descr("maximum transform rates per id", true));
+    const auto translations = declare_parameter("tag.translations", std::vector<double>{}, descr("minimum translations between transforms per id", true));
+    const auto rotations = declare_parameter("tag.rotations", std::vector<double>{}, descr("minimum rotations between transforms per id", true));
+    const auto latches = declare_parameter("tag.static", std::vector<bool>{}, descr("latch the transforms as static once converged per id", true));
+    tf_static_frames = declare_parameter("tf.static_frames", 30, descr("consecutive detections within the minimum translation and rotation before latching", true));
 
-    // detector parameters in "detector" namespace
-    declare_parameter("detector.threads", td->nthreads, descr("number of threads"));
-    declare_parameter("detector.decimate", td->quad_decimate, descr("decimate resolution for quad detection"));
-    declare_parameter("detector.blur", td->quad_sigma, descr("sigma of Gaussian blur for quad detection"));
-    declare_parameter("detector.refine", td->refine_edges, descr("snap to strong gradients"));
-    declare_parameter("detector.sharpening", td->decode_sharpening, descr("sharpening of decoded images"));
-    declare_parameter("detector.debug", td->debug, descr("write additional debugging images to working directory"));
-
-    declare_parameter<int>("max_hamming", 0, descr("reject detections with more corrected bits than allowed"));
-    declare_parameter("profile", false, descr("print profiling information to stdout"));
-    declare_parameter<bool>("z_up", true, descr("let the z axis of the tag frame point up"));
-    declare_parameter<bool>("enabled", false);
+    // the shared lists would assign the same frames to the tags of each family
+    if (tag_families.size() > 1 && !(ids.empty() && frames.empty() && sizes.empty() && rates.empty() && translations.empty() && rotations.empty() && latches.empty()))
+    {
+        throw std::runtime_error("The lists in 'tag' only apply to a single family, use 'tag.<family>' for multiple families!");
+    }
 
-    if (!frames.empty())
+    for (size_t i = 0; i < tag_families.size(); i++)
     {
-        if (ids.size() != frames.size())
+        const std::string &tag_family = tag_families[i];
+        const apriltag_family_t *tf = detector_config->families.get()[i];
+
+        // family specific tag names, IDs and sizes in "tag.<family>" namespace
+        const std::string ns = "tag." + tag_family + ".";
+        const auto family_ids = declare_parameter(ns + "ids", std::vector<int64_t>{}, descr("tag ids of family " + tag_family, true));
+        const auto family_frames = declare_parameter(ns + "frames", std::vector<std::string>{}, descr("tag frame names per id of family " + tag_family, true));
+        const auto family_sizes = declare_parameter(ns + "sizes", std::vector<double>{}, descr("tag sizes per id of family " + tag_family, true));
+        const auto family_rates = declare_parameter(ns + "rates", std::vector<double>{}, descr("maximum transform rates per id of family " + tag_family, true));
+        const auto family_translations = declare_parameter(ns + "translations", std::vector<double>{}, descr("minimum translations between transforms per id of family " + tag_family, true));
+        const auto family_rotations = declare_parameter(ns + "rotations", std::vector<double>{}, descr("minimum rotations between transforms per id of family " + tag_family, true));
+        const auto family_latches = declare_parameter(ns + "static", std::vector<bool>{}, descr("latch the transforms as static once converged per id of family " + tag_family, true));
+
+        if (family_ids.empty())
         {
-            throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and frames (" + std::to_string(frames.size()) + ") mismatch!");
+            detector_config->tags.push_back(tag_config(tf, ids, frames, sizes, tag_edge_size));
+            tf_policies.push_back(tf_config(tf, ids, rates, translations, rotations, latches));
         }
-        for (size_t i = 0; i < ids.size(); i++)
+        else
         {
-            tag_frames[ids[i]] = frames[i];
+            detector_config->tags.push_back(tag_config(tf, family_ids, family_frames, family_sizes, tag_edge_size));
+            tf_policies.push_back(tf_config(tf, family_ids, family_rates, family_translations, family_rotations, family_latches));
         }
     }
 
-    if (!sizes.empty())
+    // tag bundles in "bundle.<name>" namespace, published as a single frame
+    const auto bundle_names = declare_parameter("bundle.names", std::vector<std::string>{}, descr("names of tag bundles, used as their frame names", true));
+    for (const std::string &name : bundle_names)
     {
-        // use tag specific size
-        if (ids.size() != sizes.size())
+        const std::string ns = "bundle." + name + ".";
+        const std::string bundle_family = declare_parameter(ns + "family", tag_families.front(), descr("tag family of bundle " + name, true));
+        const auto bundle_ids = declare_parameter(ns + "ids", std::vector<int64_t>{}, descr("tag ids of bundle " + name, true));
+        const auto bundle_poses = declare_parameter(ns + "poses", std::vector<double>{}, descr("poses (x, y, z, qw, qx, qy, qz) of the tags in the frame of bundle " + name, true));
+
+        const auto it = std::find(tag_families.begin(), tag_families.end(), bundle_family);
+        if (it == tag_families.end())
         {
-            throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and sizes (" + std::to_string(sizes.size()) + ") mismatch!");
+            throw std::runtime_error("Family " + bundle_family + " of bundle " + name + " is not detected!");
         }
-        for (size_t i = 0; i < ids.size(); i++)
+        const size_t family = it - tag_families.begin();
+        const apriltag_family_t *tf = detector_config->families.get()[family];
+
+        // validates the ids
+        Bundle bundle = bundle_config(name, tf, bundle_ids, bundle_poses);
+
+        // members are detected independent of the list of tags
+        TagConfigs &tags = detector_config->tags[family];
+        for (const int64_t id : bundle_ids)
         {
-            tag_sizes[ids[i]] = sizes[i];
+            TagConfig &tag = tags.add(int(id));
+            if (tag.bundle >= 0)
+            {
+                throw std::runtime_error("Tag " + std::to_string(id) + " is a member of bundles " + detector_config->bundles[tag.bundle].name + " and " + name);
+            }
+            tag.enabled = true;
+            tag.bundle = int(detector_config->bundles.size());
         }
+        detector_config->bundles.push_back(std::move(bundle));
     }
 
-    if (tag_create.count(tag_family))
+    // static regions of interest, from rectangles and the regions of a mask
+    const auto roi_rects = declare_parameter("roi.rects", std::vector<int64_t>{}, descr("regions of interest as x, y, width and height per region", true));
+    const std::string roi_mask = declare_parameter("roi.mask", std::string{}, descr("mask image with the regions of interest as non-zero pixels", true));
+    detector_config->regions = regions(roi_rects);
+    if (!roi_mask.empty())
     {
-        tf = tag_create.at(tag_family)();
-        tf_destructor = tag_destroy.at(tag_family);
-        apriltag_detector_add_family(td, tf);
+        for (const Rect &rect : mask_regions(roi_mask))
+            detector_config->regions.push_back(rect);
+        merge_overlapping(detector_config->regions);
     }
-    else
+    if (!detector_config->regions.empty())
     {
-        throw std::runtime_error("Unsupported tag family: " + tag_family);
+        RCLCPP_INFO_STREAM(get_logger(), "detecting in " << detector_config->regions.size() << " regions of interest");
     }
+
+    config = detector_config;
+
+    // detector parameters in "detector" namespace, with the defaults of the
+    // library, applied to the detectors when they are created
+    const DetectorParameters defaults = default_parameters();
+    declare_parameter("detector.threads", defaults.nthreads, descr("number of threads"));
+    declare_parameter("detector.decimate", defaults.quad_decimate, descr("decimate resolution for quad detection"));
+    declare_parameter("detector.blur", defaults.quad_sigma, descr("sigma of Gaussian blur for quad detection"));
+    declare_parameter("detector.refine", defaults.refine_edges, descr("snap to strong gradients"));
+    declare_parameter("detector.sharpening", defaults.decode_sharpening, descr("sharpening of decoded images"));
+    declare_parameter("detector.debug", defaults.debug, descr("write additional debugging images to working directory"));
+
+    this->template declare_parameter<int>("max_hamming", 0, descr("reject detections with more corrected bits than allowed"));
+    declare_parameter("profile", false, descr("print profiling information to stdout"));
+    this->template declare_parameter<bool>("z_up", true, descr("let the z axis of the tag frame point up"));
+    declare_parameter("pose.estimator", "homography", descr("pose estimator: homography, orthogonal_iteration or lm"));
+    declare_parameter("pose.iterations", 10, descr("maximum number of iterations of the lm pose estimator"));
+    this->template declare_parameter<bool>("enabled", false);
+    declare_parameter("detection_rate", 0.0, descr("maximum rate of detected frames per camera in Hz, 0 for all frames, negative for only single-shot requests"));
+    declare_parameter("undistort", false, descr("detect in unrectified images and only undistort the tag corners"));
+
+    const double diagnostics_rate = declare_parameter("diagnostics.rate", 1.0, descr("rate of publishing timing statistics on /diagnostics, 0 to disable", true));
+
+    declare_parameter("tracking.enabled", false, descr("only search in regions around the tags of the previous frame"));
+    declare_parameter("tracking.padding", 0.5, descr("padding of the regions relative to the tag size"));
+    declare_parameter("tracking.interval", 30, descr("number of frames between full-frame searches"));
+
+    declare_parameter("filter.enabled", false, descr("filter the tag poses by a constant velocity Kalman filter"));
+    declare_parameter("filter.timeout", 0.5, descr("time in seconds after which a tag that was not detected is reset"));
+    declare_parameter("filter.process_noise", 0.1, descr("spectral density of the acceleration"));
+    declare_parameter("filter.measurement_noise", 1e-4, descr("variance of the measured position and rotation"));
+
+    if (declare_parameter("gpu", false, descr("decimate and blur full frames on the GPU")) && !GpuPreprocessor::available())
+    {
+        RCLCPP_WARN(get_logger(), "GPU preprocessing is not available, falling back to the CPU");
+    }
+
+    declare_parameter("adaptive.enabled", false, descr("adapt the decimation to the detection duration and the tag sizes"));
+    declare_parameter("adaptive.budget", 0.033, descr("budget of the detection duration in seconds"));
+    declare_parameter("adaptive.hysteresis", 0.2, descr("relative deviation from the budget without adaption"));
+    declare_parameter("adaptive.min_decimate", 1.0, descr("minimum decimation"));
+    declare_parameter("adaptive.max_decimate", 4.0, descr("maximum decimation"));
+    declare_parameter("adaptive.min_size", 12.0, descr("minimum edge length of the smallest tag in the decimated image in pixels"));
+    declare_parameter("adaptive.threads", 0, descr("maximum number of threads, 0 to keep detector.threads"));
+
+    declare_parameter("pyramid.enabled", false, descr("search full frames by a coarse pass for large tags and a fine pass in tiles"));
+    declare_parameter("pyramid.decimate", 4.0, descr("decimation of the coarse pass"));
+    declare_parameter("pyramid.tile", 512, descr("size of the tiles of the fine pass in pixels"));
+    declare_parameter("pyramid.overlap", 48, descr("overlap of the tiles, the largest edge of the tags of the fine pass in pixels"));
+
+    publish_detections = declare_parameter("publish.detections", true, descr("publish the detections", true));
+    publish_tf = declare_parameter("publish.tf", true, descr("broadcast the tag and bundle transforms on /tf", true));
+    publish_poses = declare_parameter("publish.poses", false, descr("publish the tag and bundle poses as pose array", true));
+
+    if (diagnostics_rate > 0)
+    {
+        time_diagnostics = now();
+        pub_diagnostics = rclcpp::create_publisher<diagnostic_msgs::msg::DiagnosticArray>(*this, "/diagnostics", rclcpp::QoS(1));
+        timer_diagnostics = create_wall_timer(std::chrono::duration<double>(1 / diagnostics_rate), std::bind(&AprilTagNodeBase::onDiagnostics, this));
+    }
+
+    // topics of every camera, relative to its namespace, the publishers are
+    // not managed by the lifecycle and only publish while detecting
+    const size_t ncameras = std::max<size_t>(namespaces.size(), 1);
+    for (size_t i = 0; i < ncameras; i++)
+    {
+        cameras.emplace_back(new Camera);
+        Camera &camera = *cameras.back();
+        camera.prefix = namespaces.empty() ? std::string() : namespaces[i] + "/";
+        camera.tf_states.resize(config->families.get().size());
+        if (publish_detections)
+            camera.pub_detections = rclcpp::create_publisher<apriltag_msgs::msg::AprilTagDetectionArray>(*this, camera.prefix + "detections", rclcpp::QoS(1));
+        if (publish_poses)
+            camera.pub_poses = rclcpp::create_publisher<geometry_msgs::msg::PoseArray>(*this, camera.prefix + "poses", rclcpp::QoS(1));
+        // answered after the detection of the next frame
+        camera.srv_detect = this->template create_service<std_srvs::srv::Trigger>(
+            camera.prefix + "detect",
+            [this, &camera](const std::shared_ptr<rmw_request_id_t> request, const std::shared_ptr<std_srvs::srv::Trigger::Request>) {
+                onDetect(camera, request);
+            });
+    }
+
+    const std::chrono::duration<double, std::milli> startup = std::chrono::steady_clock::now() - start;
+    RCLCPP_INFO_STREAM(get_logger(), "started in " << startup.count() << " ms, " << config->families.created() << " of "
+                                                   << config->families.get().size() << " tag families created, the others shared");
+}
+
+template <typename NodeT>
+AprilTagNodeBase<NodeT>::~AprilTagNodeBase()
+{
+    // stop the detectors before the publishers are destroyed
+    stop();
+}
+
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::start()
+{
+    if (pool)
+        return;
+
+    pool.reset(new DetectorPool(config, pool_size, cameras.size(), drop_frames, std::bind(&AprilTagNodeBase::onDetections, this, std::placeholders::_1, std::placeholders::_2)));
+    pool->configure([this](DetectorParameters &detector) {
+        detector_parameters(get_parameters(detector_parameter_names), detector);
+    });
+
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        Camera &camera = *cameras[i];
+        camera.sub_cam = camera_subscription(
+            this, camera.prefix + "image_rect",
+            [this, &camera, i](const sensor_msgs::msg::Image::ConstSharedPtr &msg_img, const sensor_msgs::msg::CameraInfo::ConstSharedPtr &msg_ci) {
+                onCamera(camera, i, msg_img, msg_ci);
+            },
+            transport, qos);
+    }
+}
+
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::stop()
+{
+    // no new frames while the detectors finish the pending frames
+    for (const std::unique_ptr<Camera> &camera : cameras)
+        camera->sub_cam.shutdown();
+
+    pool.reset();
+
+    for (const std::unique_ptr<Camera> &camera : cameras)
+        reject(*camera, "detection stopped");
+}
+
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::onDetect(Camera &camera, const std::shared_ptr<rmw_request_id_t> &request)
+{
+    if (!pool)
+    {
+        std_srvs::srv::Trigger::Response response;
+        response.success = false;
+        response.message = "detection stopped";
+        camera.srv_detect->send_response(*request, response);
+        return;
+    }
+
+    const std::lock_guard<std::mutex> lock(camera.mutex_requests);
+    camera.requests_pending.push_back(request);
+}
+
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::reject(Camera &camera, const std::string &reason)
+{
+    std::vector<std::shared_ptr<rmw_request_id_t>> requests;
+    {
+        const std::lock_guard<std::mutex> lock(camera.mutex_requests);
+        requests.swap(camera.requests_pending);
+        for (const typename Camera::Request &request : camera.requests_detecting)
+            requests.push_back(request.id);
+        camera.requests_detecting.clear();
+    }
+
+    std_srvs::srv::Trigger::Response response;
+    response.success = false;
+    response.message = reason;
+    for (const std::shared_ptr<rmw_request_id_t> &request : requests)
+        camera.srv_detect->send_response(*request, response);
 }
 
-AprilTagNode::~AprilTagNode()
+template <typename NodeT>
+rmw_qos_profile_t AprilTagNodeBase<NodeT>::qos_profile()
 {
-    apriltag_detector_destroy(td);
-    tf_destructor(tf);
+    rmw_qos_profile_t qos = rmw_qos_profile_default;
+
+    rcl_interfaces::msg::ParameterDescriptor descr_depth = descr("queue depth of the image subscription", true);
+    descr_depth.integer_range.resize(1);
+    descr_depth.integer_range[0].from_value = 1;
+    descr_depth.integer_range[0].to_value = std::numeric_limits<int32_t>::max();
+    descr_depth.integer_range[0].step = 1;
+    const int depth = declare_parameter("qos.depth", int(qos.depth), descr_depth);
+    if (depth < 1)
+    {
+        throw std::runtime_error("Queue depth (" + std::to_string(depth) + ") must be positive!");
+    }
+    qos.depth = size_t(depth);
+    const std::string reliability = declare_parameter("qos.reliability", "reliable", descr("reliability of the image subscription: reliable or best_effort", true));
+
+    if (reliability == "reliable")
+        qos.reliability = RMW_QOS_POLICY_RELIABILITY_RELIABLE;
+    else if (reliability == "best_effort")
+        qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+    else
+        throw std::runtime_error("Unsupported reliability: " + reliability);
+
+    return qos;
 }
 
-void AprilTagNode::onCamera(const sensor_msgs::msg::Image::ConstSharedPtr &msg_img,
-                            const sensor_msgs::msg::CameraInfo::ConstSharedPtr &msg_ci)
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::onCamera(Camera &camera,
+                                       const size_t stream,
+                                       const sensor_msgs::msg::Image::ConstSharedPtr &msg_img,
+                                       const sensor_msgs::msg::CameraInfo::ConstSharedPtr &msg_ci)
 {
-    if (!enabled)
+    APRILTAG_ROS_TRACE(callback, rclcpp::Time(msg_img->header.stamp).nanoseconds(), msg_img->header.frame_id.c_str());
+
+    if (!pool)
+        return;
+
+    // skip frames before their conversion, unless requested
+    const int64_t stamp = rclcpp::Time(msg_img->header.stamp).nanoseconds();
+    bool requested;
+    {
+        const std::lock_guard<std::mutex> lock(camera.mutex_requests);
+        requested = !camera.requests_pending.empty();
+    }
+    const double rate = detection_rate;
+    if (!requested && (!enabled || rate < 0))
+        return;
+    if (rate > 0)
+    {
+        // keep the average rate, restart after the stamps jumped back or
+        // after skipping more than one period
+        const int64_t period = int64_t(1e9 / rate);
+        if (!requested && camera.stamp_next >= 0 && stamp < camera.stamp_next && stamp >= camera.stamp_next - period)
+            return;
+        camera.stamp_next = (camera.stamp_next >= 0 && stamp >= camera.stamp_next && stamp - camera.stamp_next < period) ? camera.stamp_next + period : stamp + period;
+    }
+
+    // corners are only undistorted in the models of 'undistort'
+    const bool distorted = undistort && std::any_of(msg_ci->d.begin(), msg_ci->d.end(), [](const double d) { return d != 0; });
+    if (distorted && msg_ci->distortion_model != "plumb_bob" && msg_ci->distortion_model != "rational_polynomial")
+    {
+        RCLCPP_ERROR_STREAM_ONCE(get_logger(), "Unsupported distortion model " << msg_ci->distortion_model << ", expected plumb_bob or rational_polynomial!");
+        frames_rejected++;
+        reject(camera, "unsupported distortion model " + msg_ci->distortion_model);
         return;
+    }
+
+    // the data of truncated or malformed images is not wrapped or read
+    if (can_convert_mono8(msg_img->encoding) && !valid_image(msg_img->encoding, msg_img->width, msg_img->height, msg_img->step, msg_img->data.size()))
+    {
+        RCLCPP_WARN_STREAM_THROTTLE(get_logger(), *get_clock(), 5000, "Invalid " << msg_img->encoding << " image of " << msg_img->width << "x" << msg_img->height << " pixels with step " << msg_img->step << " and " << msg_img->data.size() << " bytes!");
+        frames_rejected++;
+        reject(camera, "invalid image");
+        return;
+    }
+
+    std::unique_ptr<Frame> frame(new Frame);
+    if (can_convert_mono8(msg_img->encoding))
+    {
+        frame->image = msg_img;
+        frame->encoding = msg_img->encoding;
+        frame->data = msg_img->data.data();
+        frame->width = int(msg_img->width);
+        frame->height = int(msg_img->height);
+        frame->step = int(msg_img->step);
+    }
+    else
+    {
+        // fall back to cv_bridge for other encodings
+        const cv_bridge::CvImageConstPtr img_mono8 = cv_bridge::toCvShare(msg_img, "mono8");
+        frame->image = img_mono8;
+        frame->encoding = "mono8";
+        frame->data = img_mono8->image.data;
+        frame->width = img_mono8->image.cols;
+        frame->height = img_mono8->image.rows;
+        frame->step = int(img_mono8->image.step);
+    }
+
+    // inverse projection matrix, only recomputed when the calibration changes
+    frame->intrinsics = camera.intrinsics_cache.get(msg_ci->p, msg_ci->k, msg_ci->d, undistort);
+
+    frame->stamp = stamp;
+    frame->frame_id = msg_img->header.frame_id;
+    frame->stream = stream;
+
+    // the requests are answered with the detections of this or a later frame
+    {
+        const std::lock_guard<std::mutex> lock(camera.mutex_requests);
+        for (const std::shared_ptr<rmw_request_id_t> &request : camera.requests_pending)
+            camera.requests_detecting.push_back({request, frame->stamp});
+        camera.requests_pending.clear();
+    }
 
-    // precompute inverse projection matrix
-    const Mat3 Pinv = Eigen::Map<const Eigen::Matrix<double, 3, 4, Eigen::RowMajor>>(msg_ci->p.data()).leftCols<3>().inverse();
+    pool->push(std::move(frame));
+}
 
-    // convert to 8bit monochrome image
-    const cv::Mat img_uint8 = cv_bridge::toCvShare(msg_img, "mono8")->image;
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::onDetections(const Frame &frame, const Detections &detections)
+{
+    Camera &camera = *cameras[frame.stream];
 
-    image_u8_t im{img_uint8.cols, img_uint8.rows, img_uint8.cols, img_uint8.data};
-    // detect tags
-    mutex.lock();
-    zarray_t *detections = apriltag_detector_detect(td, &im);
-    mutex.unlock();
+    std_msgs::msg::Header header;
+    header.stamp = rclcpp::Time(frame.stamp);
+    header.frame_id = frame.frame_id;
 
-    if (profile)
-        timeprofile_display(td->tp);
+    if (publish_detections)
+    {
+        // hand over a new message to intra-process subscribers without
+        // copying, otherwise fill the middleware buffer directly if supported,
+        // or reuse the buffer of the previous frame
+        std::unique_ptr<apriltag_msgs::msg::AprilTagDetectionArray> owned;
+        std::unique_ptr<rclcpp::LoanedMessage<apriltag_msgs::msg::AprilTagDetectionArray>> loaned;
+        if (camera.pub_detections->get_intra_process_subscription_count() > 0)
+        {
+            owned.reset(new apriltag_msgs::msg::AprilTagDetectionArray);
+        }
+        else if (camera.pub_detections->can_loan_messages())
+        {
+            loaned.reset(new rclcpp::LoanedMessage<apriltag_msgs::msg::AprilTagDetectionArray>(camera.pub_detections->borrow_loaned_message()));
+        }
+        apriltag_msgs::msg::AprilTagDetectionArray &msg = owned ? *owned : loaned ? loaned->get() : camera.msg_detections;
 
-    apriltag_msgs::msg::AprilTagDetectionArray msg_detections;
-    msg_detections.header = msg_img->header;
+        // resizing keeps the capacity of the strings in existing elements
+        msg.header = header;
+        msg.detections.resize(detections.tags.size());
+        for (size_t i = 0; i < detections.tags.size(); i++)
+        {
+            const Detection &detection = detections.tags[i];
+
+            apriltag_msgs::msg::AprilTagDetection &msg_detection = msg.detections[i];
+            msg_detection.family = detection.family->name;
+            msg_detection.id = detection.id;
+            msg_detection.hamming = detection.hamming;
+            msg_detection.decision_margin = detection.decision_margin;
+            msg_detection.centre.x = detection.centre[0];
+            msg_detection.centre.y = detection.centre[1];
+            std::memcpy(msg_detection.corners.data(), detection.corners.data(), sizeof(double) * 8);
+            std::memcpy(msg_detection.homography.data(), detection.homography.data(), sizeof(double) * 9);
+        }
 
-    std::vector<geometry_msgs::msg::TransformStamped> tfs;
+        if (owned)
+            camera.pub_detections->publish(std::move(owned));
+        else if (loaned)
+            camera.pub_detections->publish(std::move(*loaned));
+        else
+            camera.pub_detections->publish(msg);
+    }
 
-    for (int i = 0; i < zarray_size(detections); i++)
+    if (publish_poses)
     {
-        apriltag_detection_t *det;
-        zarray_get(detections, i, &det);
+        // all tags in the order of the detections, followed by the bundles
+        std::unique_ptr<geometry_msgs::msg::PoseArray> owned;
+        if (camera.pub_poses->get_intra_process_subscription_count() > 0)
+        {
+            owned.reset(new geometry_msgs::msg::PoseArray);
+        }
+        geometry_msgs::msg::PoseArray &msg = owned ? *owned : camera.msg_poses;
 
-        // ignore untracked tags
-        if (!tag_frames.empty() && !tag_frames.count(det->id))
+        msg.header = header;
+        msg.poses.resize(detections.tags.size() + detections.bundles.size());
+        for (size_t i = 0; i < detections.tags.size(); i++)
         {
-            continue;
+            toPose(detections.tags[i].pose, msg.poses[i]);
+        }
+        for (size_t i = 0; i < detections.bundles.size(); i++)
+        {
+            toPose(detections.bundles[i].pose, msg.poses[detections.tags.size() + i]);
         }
 
-        // reject detections with more corrected bits than allowed
-        if (det->hamming > max_hamming)
+        if (owned)
+            camera.pub_poses->publish(std::move(owned));
+        else
+            camera.pub_poses->publish(msg);
+    }
+
+    if (publish_tf)
+    {
+        std::vector<geometry_msgs::msg::TransformStamped> &tfs = camera.tfs;
+        std::vector<geometry_msgs::msg::TransformStamped> &tfs_static = camera.tfs_static;
+        size_t ntfs = 0, ntfs_static = 0, nsuppressed = 0;
+
+        const auto add_transform = [&header](std::vector<geometry_msgs::msg::TransformStamped> &tfs, size_t &ntfs, const std::string &child_frame_id, const Pose &pose) {
+            if (ntfs == tfs.size())
+                tfs.emplace_back();
+            geometry_msgs::msg::TransformStamped &tf = tfs[ntfs++];
+            tf.header = header;
+            tf.child_frame_id = child_frame_id;
+            toTransform(pose, tf.transform);
+        };
+
+        // 3D orientation and position, members are part of the bundle transform
+        for (const Detection &detection : detections.tags)
         {
-            continue;
+            if (detection.bundle)
+                continue;
+
+            const size_t family = config->families.index(detection.family);
+            switch (tf_action(tf_policies[family].get(detection.id), camera.tf_states[family].get(detection.id), detection.pose, frame.stamp, tf_static_frames))
+            {
+            case TfAction::Suppress:
+                nsuppressed++;
+                break;
+            case TfAction::Publish:
+                add_transform(tfs, ntfs, *detection.frame, detection.pose);
+                break;
+            case TfAction::Latch:
+                add_transform(tfs_static, ntfs_static, *detection.frame, detection.pose);
+                break;
+            }
+        }
+
+        for (const BundleDetection &bundle : detections.bundles)
+        {
+            add_transform(tfs, ntfs, bundle.bundle->name, bundle.pose);
+        }
+
+        tfs.resize(ntfs);
+        tfs_static.resize(ntfs_static);
+        if (!tfs.empty())
+            tf_broadcaster.sendTransform(tfs);
+        // replaces the earlier static transforms with the same child frame
+        if (!tfs_static.empty())
+            tf_static_broadcaster.sendTransform(tfs_static);
+
+        tfs_published += ntfs;
+        tfs_latched += ntfs_static;
+        tfs_suppressed += nsuppressed;
+    }
+
+    // answer the single-shot requests of this or an earlier, dropped frame
+    std::vector<std::shared_ptr<rmw_request_id_t>> requests;
+    {
+        const std::lock_guard<std::mutex> lock(camera.mutex_requests);
+        auto &detecting = camera.requests_detecting;
+        for (const typename Camera::Request &request : detecting)
+        {
+            if (request.stamp <= frame.stamp)
+                requests.push_back(request.id);
         }
+        detecting.erase(std::remove_if(detecting.begin(), detecting.end(), [&frame](const typename Camera::Request &request) { return request.stamp <= frame.stamp; }), detecting.end());
+    }
+    if (!requests.empty())
+    {
+        // the frames of the detected tags and bundles, the poses are
+        // published as usual
+        std_srvs::srv::Trigger::Response response;
+        response.success = !detections.tags.empty();
+        response.message = "detected " + std::to_string(detections.tags.size()) + " tags and " + std::to_string(detections.bundles.size()) + " bundles";
+        for (const Detection &detection : detections.tags)
+            response.message += " " + *detection.frame;
+        for (const BundleDetection &bundle : detections.bundles)
+            response.message += " " + bundle.bundle->name;
+        for (const std::shared_ptr<rmw_request_id_t> &request : requests)
+            camera.srv_detect->send_response(*request, response);
+    }
+
+    APRILTAG_ROS_TRACE(publish, frame.stamp, frame.frame_id.c_str());
 
-        // detection
-        apriltag_msgs::msg::AprilTagDetection msg_detection;
-        msg_detection.family = std::string(det->family->name);
-        msg_detection.id = det->id;
-        msg_detection.hamming = det->hamming;
-        msg_detection.decision_margin = det->decision_margin;
-        msg_detection.centre.x = det->c[0];
-        msg_detection.centre.y = det->c[1];
-        std::memcpy(msg_detection.corners.data(), det->p, sizeof(double) * 8);
-        std::memcpy(msg_detection.homography.data(), det->H->data, sizeof(double) * 9);
-        msg_detections.detections.push_back(msg_detection);
+    const rclcpp::Time time = now();
+    latency.add((time - rclcpp::Time(frame.stamp, time.get_clock_type())).seconds());
+}
+
+template <typename NodeT>
+void AprilTagNodeBase<NodeT>::onDiagnostics()
+{
+    // no statistics while inactive
+    if (!pool)
+        return;
 
-        // 3D orientation and position
-        geometry_msgs::msg::TransformStamped tf;
-        tf.header = msg_img->header;
-        // set child frame name by generic tag name or configured tag name
-        tf.child_frame_id = tag_frames.count(det->id) ? tag_frames.at(det->id) : std::string(det->family->name) + ":" + std::to_string(det->id);
-        getPose(*(det->H), Pinv, tf.transform, tag_sizes.count(det->id) ? tag_sizes.at(det->id) : tag_edge_size, z_up);
+    const rclcpp::Time time = now();
+    const double interval = (time - time_diagnostics).seconds();
+    time_diagnostics = time;
 
-        tfs.push_back(tf);
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.name = get_fully_qualified_name();
+    status.message = "detection statistics";
+
+    const auto add_value = [&status](const std::string &key, const double value) {
+        diagnostic_msgs::msg::KeyValue kv;
+        kv.key = key;
+        kv.value = std::to_string(value);
+        status.values.push_back(kv);
+    };
+
+    // durations in milliseconds
+    const auto add_summary = [&add_value](const std::string &name, Histogram &histogram, const double scale) {
+        const Histogram::Summary summary = histogram.collect();
+        add_value(name + " min", summary.min * scale);
+        add_value(name + " mean", summary.mean * scale);
+        add_value(name + " p99", summary.p99 * scale);
+        add_value(name + " max", summary.max * scale);
+    };
+
+    Metrics &metrics = pool->metrics();
+
+    const uint64_t frames_processed = metrics.frames_processed.exchange(0);
+    const uint64_t frames_dropped = metrics.frames_dropped.exchange(0);
+    add_value("frames processed", frames_processed);
+    add_value("frames dropped", frames_dropped);
+    add_value("frames rejected", frames_rejected.exchange(0));
+    add_value("frame rate [Hz]", interval > 0 ? frames_processed / interval : 0);
+    if (publish_tf)
+    {
+        add_value("tf published", tfs_published.exchange(0));
+        add_value("tf static", tfs_latched.exchange(0));
+        add_value("tf suppressed", tfs_suppressed.exchange(0));
     }
 
-    pub_detections->publish(msg_detections);
-    tf_broadcaster.sendTransform(tfs);
+    add_summary("conversion [ms]", metrics.conversion, 1e3);
+    add_summary("detection [ms]", metrics.detection, 1e3);
+    for (size_t i = 0; i < metrics.stages_named; i++)
+    {
+        add_summary("detector " + metrics.stage_names[i] + " [ms]", metrics.stages[i], 1e3);
+    }
+    for (size_t i = 0; i < npose_estimators; i++)
+    {
+        // only the estimators used in this interval
+        const Histogram::Summary summary = metrics.pose[i].collect();
+        if (!summary.count)
+            continue;
+        const std::string name = std::string("pose ") + pose_estimator_name(PoseEstimator(i)) + " [ms]";
+        add_value(name + " min", summary.min * 1e3);
+        add_value(name + " mean", summary.mean * 1e3);
+        add_value(name + " p99", summary.p99 * 1e3);
+        add_value(name + " max", summary.max * 1e3);
+    }
+    add_summary("publish [ms]", metrics.publish, 1e3);
+    add_summary("latency [ms]", latency, 1e3);
+    add_summary("detections per frame", metrics.detections, 1);
+    add_summary("scratch [KiB]", metrics.scratch, 1.0 / 1024);
+    // only with adaptive decimation
+    const Histogram::Summary decimate = metrics.decimate.collect();
+    if (decimate.count)
+    {
+        add_value("decimate min", decimate.min);
+        add_value("decimate mean", decimate.mean);
+        add_value("decimate max", decimate.max);
+    }
 
-    apriltag_detections_destroy(detections);
+    diagnostic_msgs::msg::DiagnosticArray msg;
+    msg.header.stamp = time;
+    msg.status.push_back(status);
+    pub_diagnostics->publish(msg);
 }
 
+template <typename NodeT>
 rcl_interfaces::msg::SetParametersResult
-AprilTagNode::onParameter(const std::vector<rclcpp::Parameter> &parameters)
+AprilTagNodeBase<NodeT>::onParameter(const std::vector<rclcpp::Parameter> &parameters)
 {
     rcl_interfaces::msg::SetParametersResult result;
 
-    mutex.lock();
+    // reject unsupported values before any parameter is applied
+    for (const rclcpp::Parameter &parameter : parameters)
+    {
+        try
+        {
+            if (parameter.get_name() == "pose.estimator")
+                pose_estimator(parameter.get_value<std::string>());
+        }
+        catch (const std::runtime_error &e)
+        {
+            result.successful = false;
+            result.reason = e.what();
+            return result;
+        }
+    }
+
+    // apply all parameters to the detectors at once
+    if (pool)
+    {
+        pool->configure([&parameters](DetectorParameters &detector) {
+            detector_parameters(parameters, detector);
+        });
+    }
 
     for (const rclcpp::Parameter &parameter : parameters)
     {
         RCLCPP_DEBUG_STREAM(get_logger(), "setting: " << parameter);
 
-        IF("detector.threads", td->nthreads)
-        IF("detector.decimate", td->quad_decimate)
-        IF("detector.blur", td->quad_sigma)
-        IF("detector.refine", td->refine_edges)
-        IF("detector.sharpening", td->decode_sharpening)
-        IF("detector.debug", td->debug)
-        IF("max_hamming", max_hamming)
-        IF("profile", profile)
-        IF("z_up", z_up)
         IF("enabled", enabled)
+        IF("detection_rate", detection_rate)
+        IF("undistort", undistort)
     }
 
-    mutex.unlock();
+    // apply all settings at once, as a single snapshot for the next frames
+    if (config)
+    {
+        config->configure([&parameters](Settings &settings) {
+            for (const rclcpp::Parameter &parameter : parameters)
+            {
+                IF("max_hamming", settings.max_hamming)
+                IF("profile", settings.profile)
+                IF("z_up", settings.z_up)
+                IF("pose.iterations", settings.pose_iterations)
+                IF("tracking.enabled", settings.tracking)
+                IF("tracking.padding", settings.tracking_padding)
+                IF("tracking.interval", settings.tracking_interval)
+                IF("filter.enabled", settings.filter)
+                IF("filter.timeout", settings.filter_timeout)
+                IF("filter.process_noise", settings.filter_process_noise)
+                IF("filter.measurement_noise", settings.filter_measurement_noise)
+                IF("adaptive.enabled", settings.adaptive)
+                IF("adaptive.budget", settings.adaptive_budget)
+                IF("adaptive.hysteresis", settings.adaptive_hysteresis)
+                IF("adaptive.min_decimate", settings.adaptive_min_decimate)
+                IF("adaptive.max_decimate", settings.adaptive_max_decimate)
+                IF("adaptive.min_size", settings.adaptive_min_size)
+                IF("adaptive.threads", settings.adaptive_threads)
+                IF("gpu", settings.gpu)
+                IF("pyramid.enabled", settings.pyramid)
+                IF("pyramid.decimate", settings.pyramid_decimate)
+                IF("pyramid.tile", settings.pyramid_tile)
+                IF("pyramid.overlap", settings.pyramid_overlap)
+
+                if (parameter.get_name() == "pose.estimator")
+                    settings.estimator = pose_estimator(parameter.get_value<std::string>());
+            }
+        });
+    }
 
     result.successful = true;
 
@@ -0,0 +1,78 @@
+#include "apriltag_ros/adaptive.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// The library decimates by 1.5 or by the integer part of 'quad_decimate'.
+static float step_up(const float decimate)
+{
+    if (decimate < 1.5f)
+        return 1.5f;
+    if (decimate < 2)
+        return 2;
+    return std::floor(decimate) + 1;
+}
+
+static float step_down(const float decimate)
+{
+    if (decimate > 2)
+        return std::ceil(decimate) - 1;
+    if (decimate > 1.5f)
+        return 1.5f;
+    return 1;
+}
+
+double min_edge(const Detections::Tags &tags)
+{
+    double edge = std::numeric_limits<double>::infinity();
+    for (const Detection &tag : tags)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            const size_t j = (i + 1) % 4;
+            edge = std::min(edge, std::hypot(tag.corners[2 * j] - tag.corners[2 * i], tag.corners[2 * j + 1] - tag.corners[2 * i + 1]));
+        }
+    }
+    return edge;
+}
+
+void AdaptiveDecimation::update(const double duration, const Detections::Tags &tags, const Settings &settings)
+{
+    const double budget = settings.adaptive_budget;
+    const double hysteresis = settings.adaptive_hysteresis;
+    const float min_decimate = std::max(1.0f, float(settings.adaptive_min_decimate));
+    const float max_decimate = std::max(min_decimate, float(settings.adaptive_max_decimate));
+    const int max_threads = settings.adaptive_threads;
+
+    decimate = std::min(std::max(decimate, min_decimate), max_decimate);
+    if (max_threads > 0)
+        threads = std::min(std::max(threads, 1), max_threads);
+
+    // largest decimation that keeps 'adaptive_min_size' pixels per tag edge
+    const float limit = std::max(min_decimate, float(std::min<double>(max_decimate, min_edge(tags) / settings.adaptive_min_size)));
+
+    if (decimate > limit)
+    {
+        // the smallest tag would get lost, independent of the budget
+        decimate = std::max(step_down(decimate), min_decimate);
+    }
+    else if (duration > budget * (1 + hysteresis))
+    {
+        // prefer more threads over a lower resolution
+        if (threads < max_threads)
+            threads++;
+        else if (step_up(decimate) <= limit)
+            decimate = step_up(decimate);
+    }
+    else if (duration < budget * (1 - hysteresis))
+    {
+        // only step down if the predicted duration stays within the budget,
+        // the quad detection scales with the number of decimated pixels
+        const float down = std::max(step_down(decimate), min_decimate);
+        if (down < decimate && duration * (decimate / down) * (decimate / down) < budget)
+            decimate = down;
+        else if (max_threads > 0 && threads > 1 && duration * threads / (threads - 1) < budget)
+            threads--;
+    }
+}
@@ -0,0 +1,625 @@
+// Benchmark of the detection and pose estimation on a directory of images,
+// without ROS transport, over a sweep of detector parameters. The results can
+// be recorded as baseline and later checked against it as regression test.
+
+#include "apriltag_ros/intrinsics.hpp"
+#include "apriltag_ros/tag_detector.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char *usage =
+    "usage: apriltag_ros_benchmark --images <directory> --camera <fx,fy,cx,cy> [options]\n"
+    "\n"
+    "options:\n"
+    "  --family <name>        tag family (default: 36h11)\n"
+    "  --size <m>             tag edge size (default: 1.0)\n"
+    "  --z-up <0|1>           let the z axis of the tag frame point up (default: 1)\n"
+    "  --max-hamming <n>      maximum allowed hamming distance (default: 0)\n"
+    "  --decimate <list>      comma separated values of 'detector.decimate' (default: 2)\n"
+    "  --threads <list>       comma separated values of 'detector.threads' (default: 1)\n"
+    "  --blur <list>          comma separated values of 'detector.blur' (default: 0)\n"
+    "  --refine <list>        comma separated values of 'detector.refine' (default: 1)\n"
+    "  --pose <list>          comma separated pose estimators: homography, orthogonal_iteration,\n"
+    "                         lm (default: homography)\n"
+    "  --pose-iterations <n>  maximum number of iterations of the lm pose estimator (default: 10)\n"
+    "  --pyramid <list>       comma separated values of 'pyramid.enabled', e.g. 0,1 to compare\n"
+    "                         the coarse and fine passes with a plain pass (default: 0)\n"
+    "  --repeat <n>           number of passes over the images (default: 1)\n"
+    "  --ground-truth <file>  CSV with lines 'image,id[,x,y,z,qw,qx,qy,qz]' of the expected\n"
+    "                         tags and their optional pose in the camera frame\n"
+    "  --record-baseline <file>  write the detections, throughput and stage durations\n"
+    "  --check-baseline <file>   compare with a recorded baseline, fails on differences\n"
+    "                         and regressions, the throughput is only compared if recorded\n"
+    "  --corner-tolerance <px>   maximum corner difference to the baseline (default: 0.5)\n"
+    "  --translation-tolerance <m>  maximum translation difference (default: 0.01)\n"
+    "  --rotation-tolerance <deg>   maximum rotation difference (default: 1)\n"
+    "  --max-regression <percent>   maximum throughput loss against the baseline, slower\n"
+    "                         stages are reported (default: 10)\n";
+
+struct Config
+{
+    double decimate;
+    int threads;
+    double blur;
+    bool refine;
+    PoseEstimator estimator;
+    bool pyramid;
+};
+
+struct GroundTruth
+{
+    int id;
+    bool has_pose;
+    Pose pose;
+};
+
+// detection of the first pass in an image, with the pose as
+// (x, y, z, qw, qx, qy, qz)
+struct Result
+{
+    std::string image;
+    int id;
+    std::array<double, 8> corners;
+    std::array<double, 7> pose;
+};
+
+// results per configuration, indexed by 'config_name'
+struct Baseline
+{
+    std::map<std::string, double> throughput;
+    // p50 duration per stage in milliseconds
+    std::map<std::string, std::map<std::string, double>> stages;
+    std::map<std::string, std::vector<Result>> tags;
+};
+
+struct Image
+{
+    std::string name;
+    cv::Mat mono8;
+    std::vector<GroundTruth> tags;
+};
+
+static std::vector<double> parse_list(const std::string &list)
+{
+    std::vector<double> values;
+    std::stringstream ss(list);
+    std::string value;
+    while (std::getline(ss, value, ','))
+    {
+        values.push_back(std::stod(value));
+    }
+    if (values.empty())
+    {
+        throw std::runtime_error("empty list: '" + list + "'");
+    }
+    return values;
+}
+
+static std::vector<std::string> parse_names(const std::string &list)
+{
+    std::vector<std::string> names;
+    std::stringstream ss(list);
+    std::string name;
+    while (std::getline(ss, name, ','))
+    {
+        names.push_back(name);
+    }
+    if (names.empty())
+    {
+        throw std::runtime_error("empty list: '" + list + "'");
+    }
+    return names;
+}
+
+static std::string basename(const std::string &path)
+{
+    const size_t pos = path.find_last_of('/');
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+static std::map<std::string, std::vector<GroundTruth>> read_ground_truth(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open ground truth: " + path);
+    }
+
+    std::map<std::string, std::vector<GroundTruth>> ground_truth;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream ss(line);
+        std::string name, value;
+        std::getline(ss, name, ',');
+        std::vector<double> values;
+        while (std::getline(ss, value, ','))
+        {
+            values.push_back(std::stod(value));
+        }
+
+        if (values.size() != 1 && values.size() != 8)
+        {
+            throw std::runtime_error("invalid ground truth line: '" + line + "'");
+        }
+
+        GroundTruth gt;
+        gt.id = int(values[0]);
+        gt.has_pose = (values.size() == 8);
+        if (gt.has_pose)
+        {
+            gt.pose.translation = {values[1], values[2], values[3]};
+            gt.pose.rotation = Eigen::Quaterniond(values[4], values[5], values[6], values[7]).normalized();
+        }
+        ground_truth[name].push_back(gt);
+    }
+
+    return ground_truth;
+}
+
+static std::string config_name(const Config &config)
+{
+    std::stringstream ss;
+    ss << "decimate=" << config.decimate << " threads=" << config.threads << " blur=" << config.blur << " refine=" << config.refine << " pose=" << pose_estimator_name(config.estimator);
+    // keeps the names of the baselines recorded without pyramid
+    if (config.pyramid)
+        ss << " pyramid=1";
+    return ss.str();
+}
+
+// CSV with lines 'throughput,<config>,<frames/s>', 'stage,<config>,<name>,<ms>'
+// and 'tag,<config>,<image>,<id>,<8 corners>,<7 pose values>'
+static void write_baseline(const std::string &path, const Baseline &baseline)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("cannot write baseline: " + path);
+    }
+
+    file << std::setprecision(17);
+    for (const auto &throughput : baseline.throughput)
+    {
+        file << "throughput," << throughput.first << "," << throughput.second << "\n";
+    }
+    for (const auto &stages : baseline.stages)
+    {
+        for (const auto &stage : stages.second)
+            file << "stage," << stages.first << "," << stage.first << "," << stage.second << "\n";
+    }
+    for (const auto &tags : baseline.tags)
+    {
+        for (const Result &result : tags.second)
+        {
+            file << "tag," << tags.first << "," << result.image << "," << result.id;
+            for (const double c : result.corners)
+                file << "," << c;
+            for (const double v : result.pose)
+                file << "," << v;
+            file << "\n";
+        }
+    }
+}
+
+static Baseline read_baseline(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open baseline: " + path);
+    }
+
+    Baseline baseline;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream ss(line);
+        std::vector<std::string> fields;
+        std::string field;
+        while (std::getline(ss, field, ','))
+        {
+            fields.push_back(field);
+        }
+
+        if (fields.size() == 3 && fields[0] == "throughput")
+        {
+            baseline.throughput[fields[1]] = std::stod(fields[2]);
+        }
+        else if (fields.size() == 4 && fields[0] == "stage")
+        {
+            baseline.stages[fields[1]][fields[2]] = std::stod(fields[3]);
+        }
+        else if (fields.size() == 4 + 8 + 7 && fields[0] == "tag")
+        {
+            Result result;
+            result.image = fields[2];
+            result.id = std::stoi(fields[3]);
+            for (size_t i = 0; i < 8; i++)
+                result.corners[i] = std::stod(fields[4 + i]);
+            for (size_t i = 0; i < 7; i++)
+                result.pose[i] = std::stod(fields[12 + i]);
+            baseline.tags[fields[1]].push_back(result);
+        }
+        else
+        {
+            throw std::runtime_error("invalid baseline line: '" + line + "'");
+        }
+    }
+
+    return baseline;
+}
+
+struct Tolerance
+{
+    double corner;
+    double translation;
+    double rotation; // degrees
+    double regression; // relative
+};
+
+// print the differences to the baseline and return their number
+static size_t check_baseline(const std::string &config, const Baseline &baseline, const Baseline &current, const Tolerance &tolerance)
+{
+    if (!baseline.throughput.count(config) && !baseline.tags.count(config))
+    {
+        std::cout << "  baseline: configuration not recorded" << std::endl;
+        return 1;
+    }
+
+    size_t failures = 0;
+
+    // baselines of only the detections, e.g. of synthetic images, do not
+    // depend on the machine
+    if (baseline.throughput.count(config))
+    {
+        const double throughput = current.throughput.at(config);
+        const double throughput_baseline = baseline.throughput.at(config);
+        const double change = throughput / throughput_baseline - 1;
+        const bool regressed = change < -tolerance.regression;
+        std::cout << "  baseline throughput: " << throughput_baseline << " frames/s (" << std::showpos << 100 * change << std::noshowpos << "%)" << (regressed ? " REGRESSION" : "") << std::endl;
+        failures += regressed;
+    }
+    else
+    {
+        std::cout << "  baseline throughput: not recorded" << std::endl;
+    }
+
+    // stage durations are noisy, only reported
+    if (baseline.stages.count(config))
+    {
+        for (const auto &stage : current.stages.at(config))
+        {
+            const auto &stages = baseline.stages.at(config);
+            if (!stages.count(stage.first) || !(stages.at(stage.first) > 0))
+                continue;
+            const double slowdown = stage.second / stages.at(stage.first) - 1;
+            if (slowdown > tolerance.regression)
+                std::cout << "  baseline stage " << stage.first << ": " << stages.at(stage.first) << " ms, +" << 100 * slowdown << "% slower" << std::endl;
+        }
+    }
+
+    const auto key = [](const Result &result) { return std::make_pair(result.image, result.id); };
+    std::map<std::pair<std::string, int>, const Result *> expected;
+    if (baseline.tags.count(config))
+    {
+        for (const Result &result : baseline.tags.at(config))
+            expected[key(result)] = &result;
+    }
+    std::map<std::pair<std::string, int>, const Result *> detected;
+    for (const Result &result : current.tags.at(config))
+        detected[key(result)] = &result;
+
+    for (const auto &tag : expected)
+    {
+        const std::string name = tag.first.first + " tag " + std::to_string(tag.first.second);
+        if (!detected.count(tag.first))
+        {
+            std::cout << "  baseline: " << name << " not detected" << std::endl;
+            failures++;
+            continue;
+        }
+        const Result &a = *tag.second;
+        const Result &b = *detected.at(tag.first);
+
+        double corner = 0;
+        for (size_t i = 0; i < 8; i++)
+            corner = std::max(corner, std::abs(a.corners[i] - b.corners[i]));
+        const double translation = (Eigen::Vector3d(a.pose[0], a.pose[1], a.pose[2]) - Eigen::Vector3d(b.pose[0], b.pose[1], b.pose[2])).norm();
+        const double rotation = Eigen::Quaterniond(a.pose[3], a.pose[4], a.pose[5], a.pose[6]).angularDistance(Eigen::Quaterniond(b.pose[3], b.pose[4], b.pose[5], b.pose[6])) * 180 / EIGEN_PI;
+        if (corner > tolerance.corner || translation > tolerance.translation || rotation > tolerance.rotation)
+        {
+            std::cout << "  baseline: " << name << " differs by " << corner << " px, " << translation << " m, " << rotation << " deg" << std::endl;
+            failures++;
+        }
+    }
+    for (const auto &tag : detected)
+    {
+        if (!expected.count(tag.first))
+        {
+            std::cout << "  baseline: " << tag.first.first << " tag " << tag.first.second << " detected but not expected" << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+static double percentile(std::vector<double> values, const double p)
+{
+    if (values.empty())
+        return 0;
+    const size_t n = std::min(values.size() - 1, size_t(std::ceil(p * values.size())) - 1);
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> args = {
+        {"--family", "36h11"},
+        {"--size", "1.0"},
+        {"--z-up", "1"},
+        {"--max-hamming", "0"},
+        {"--decimate", "2"},
+        {"--threads", "1"},
+        {"--blur", "0"},
+        {"--refine", "1"},
+        {"--pose", "homography"},
+        {"--pose-iterations", "10"},
+        {"--pyramid", "0"},
+        {"--repeat", "1"},
+        {"--corner-tolerance", "0.5"},
+        {"--translation-tolerance", "0.01"},
+        {"--rotation-tolerance", "1"},
+        {"--max-regression", "10"},
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+        {
+            std::cout << usage;
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "missing value for " << arg << std::endl << usage;
+            return 1;
+        }
+        args[arg] = argv[++i];
+    }
+
+    if (!args.count("--images") || !args.count("--camera"))
+    {
+        std::cerr << usage;
+        return 1;
+    }
+
+    try
+    {
+        const std::string family = args.at("--family");
+        // the families are shared by the detectors of all configurations
+        const std::shared_ptr<DetectorConfig> detector_config = std::make_shared<DetectorConfig>(std::vector<std::string>{family});
+        const apriltag_family_t *tf = detector_config->families.get().front();
+        detector_config->tags.push_back(tag_config(tf, {}, {}, {}, std::stod(args.at("--size"))));
+        detector_config->configure([&args](Settings &settings) {
+            settings.z_up = std::stoi(args.at("--z-up"));
+            settings.max_hamming = std::stoi(args.at("--max-hamming"));
+            settings.pose_iterations = std::stoi(args.at("--pose-iterations"));
+        });
+
+        const int repeat = std::stoi(args.at("--repeat"));
+
+        Baseline baseline, current;
+        if (args.count("--check-baseline"))
+        {
+            baseline = read_baseline(args.at("--check-baseline"));
+        }
+        const Tolerance tolerance = {
+            std::stod(args.at("--corner-tolerance")),
+            std::stod(args.at("--translation-tolerance")),
+            std::stod(args.at("--rotation-tolerance")),
+            std::stod(args.at("--max-regression")) / 100,
+        };
+        size_t failures = 0;
+
+        // projection matrix of the rectified images
+        const std::vector<double> camera = parse_list(args.at("--camera"));
+        if (camera.size() != 4)
+        {
+            throw std::runtime_error("camera intrinsics must be 'fx,fy,cx,cy'");
+        }
+        const std::array<double, 12> p = {camera[0], 0, camera[2], 0, 0, camera[1], camera[3], 0, 0, 0, 1, 0};
+        const std::array<double, 9> k = {camera[0], 0, camera[2], 0, camera[1], camera[3], 0, 0, 1};
+        IntrinsicsCache intrinsics_cache;
+        const std::shared_ptr<const Intrinsics> intrinsics = intrinsics_cache.get(p, k, {});
+
+        std::map<std::string, std::vector<GroundTruth>> ground_truth;
+        if (args.count("--ground-truth"))
+        {
+            ground_truth = read_ground_truth(args.at("--ground-truth"));
+        }
+
+        // load all images before measuring
+        std::vector<cv::String> paths;
+        cv::glob(args.at("--images"), paths, false);
+        std::sort(paths.begin(), paths.end());
+        std::vector<Image> images;
+        for (const cv::String &path : paths)
+        {
+            const cv::Mat mono8 = cv::imread(path, cv::IMREAD_GRAYSCALE);
+            if (mono8.empty())
+                continue;
+            const std::string name = basename(path);
+            images.push_back({name, mono8, ground_truth.count(name) ? ground_truth.at(name) : std::vector<GroundTruth>{}});
+        }
+        if (images.empty())
+        {
+            throw std::runtime_error("no images in " + args.at("--images"));
+        }
+        std::cout << "images: " << images.size() << std::endl;
+
+        // sweep over all combinations of detector parameters
+        std::vector<Config> configs;
+        for (const double decimate : parse_list(args.at("--decimate")))
+            for (const double threads : parse_list(args.at("--threads")))
+                for (const double blur : parse_list(args.at("--blur")))
+                    for (const double refine : parse_list(args.at("--refine")))
+                        for (const std::string &estimator : parse_names(args.at("--pose")))
+                            for (const double pyramid : parse_list(args.at("--pyramid")))
+                                configs.push_back({decimate, int(threads), blur, bool(refine), pose_estimator(estimator), bool(pyramid)});
+
+        for (const Config &config : configs)
+        {
+            detector_config->configure([&config](Settings &settings) {
+                settings.estimator = config.estimator;
+                settings.pyramid = config.pyramid;
+            });
+            TagDetector detector(detector_config);
+            DetectorParameters parameters = default_parameters();
+            parameters.quad_decimate = float(config.decimate);
+            parameters.nthreads = config.threads;
+            parameters.quad_sigma = float(config.blur);
+            parameters.refine_edges = config.refine;
+            detector.configure(parameters);
+
+            const std::string name = config_name(config);
+            std::vector<Result> &results = current.tags[name];
+
+            typedef std::chrono::steady_clock clock;
+            std::map<std::string, std::vector<double>> durations;
+            std::vector<std::string> stages;
+            size_t expected = 0, found = 0, poses = 0;
+            double error_t_sum = 0, error_t_max = 0, error_r_sum = 0, error_r_max = 0;
+
+            const clock::time_point t_begin = clock::now();
+            for (int r = 0; r < repeat; r++)
+            {
+                for (const Image &image : images)
+                {
+                    const Detections::Tags &detections = detector.detect("mono8", image.mono8.data, image.mono8.cols, image.mono8.rows, int(image.mono8.step), *intrinsics).tags;
+
+                    std::map<int, Pose, std::less<int>, Eigen::aligned_allocator<std::pair<const int, Pose>>> estimates;
+                    for (const Detection &detection : detections)
+                    {
+                        estimates[detection.id] = detection.pose;
+                    }
+
+                    // milliseconds
+                    const Timings &timings = detector.timings();
+                    durations["conversion"].push_back(timings.conversion * 1e3);
+                    durations["detection"].push_back(timings.detection * 1e3);
+                    durations["pose"].push_back(timings.pose * 1e3);
+                    durations["total"].push_back((timings.conversion + timings.detection + timings.pose) * 1e3);
+
+                    // detector stages
+                    for (const Stage &stage : timings.stages)
+                    {
+                        if (!durations.count(stage.name))
+                            stages.push_back(stage.name);
+                        durations[stage.name].push_back(stage.duration * 1e3);
+                    }
+
+                    // recall and pose error of the first pass
+                    if (r > 0)
+                        continue;
+                    for (const Detection &detection : detections)
+                    {
+                        const Pose &pose = detection.pose;
+                        results.push_back({image.name, detection.id, detection.corners, {pose.translation.x(), pose.translation.y(), pose.translation.z(), pose.rotation.w(), pose.rotation.x(), pose.rotation.y(), pose.rotation.z()}});
+                    }
+                    for (const GroundTruth &gt : image.tags)
+                    {
+                        expected++;
+                        if (!estimates.count(gt.id))
+                            continue;
+                        found++;
+                        if (!gt.has_pose)
+                            continue;
+                        const Pose &estimate = estimates.at(gt.id);
+                        const double error_t = (estimate.translation - gt.pose.translation).norm();
+                        const double error_r = estimate.rotation.angularDistance(gt.pose.rotation) * 180 / EIGEN_PI;
+                        error_t_sum += error_t;
+                        error_r_sum += error_r;
+                        error_t_max = std::max(error_t_max, error_t);
+                        error_r_max = std::max(error_r_max, error_r);
+                        poses++;
+                    }
+                }
+            }
+            const std::chrono::duration<double> elapsed = clock::now() - t_begin;
+
+            std::cout << std::endl
+                      << "decimate: " << config.decimate << ", threads: " << config.threads << ", blur: " << config.blur << ", refine: " << config.refine << ", pose: " << pose_estimator_name(config.estimator) << ", pyramid: " << config.pyramid << std::endl;
+            current.throughput[name] = (repeat * images.size()) / elapsed.count();
+            std::cout << "  throughput: " << current.throughput[name] << " frames/s" << std::endl;
+            std::cout << "  " << std::left << std::setw(24) << "stage [ms]" << std::right
+                      << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::endl;
+            std::vector<std::string> rows = {"conversion", "detection"};
+            rows.insert(rows.end(), stages.begin(), stages.end());
+            rows.insert(rows.end(), {"pose", "total"});
+            for (const std::string &row : rows)
+            {
+                const std::vector<double> &d = durations.at(row);
+                current.stages[name][row] = percentile(d, 0.5);
+                std::cout << "  " << std::left << std::setw(24) << row << std::right << std::fixed << std::setprecision(3)
+                          << std::setw(10) << percentile(d, 0.5) << std::setw(10) << percentile(d, 0.9) << std::setw(10) << percentile(d, 0.99)
+                          << std::defaultfloat << std::endl;
+            }
+            if (expected)
+            {
+                std::cout << "  recall: " << double(found) / expected << " (" << found << "/" << expected << ")" << std::endl;
+            }
+            if (poses)
+            {
+                std::cout << "  translation error [m]: mean " << error_t_sum / poses << ", max " << error_t_max << std::endl;
+                std::cout << "  rotation error [deg]: mean " << error_r_sum / poses << ", max " << error_r_max << std::endl;
+            }
+            if (args.count("--check-baseline"))
+            {
+                failures += check_baseline(name, baseline, current, tolerance);
+            }
+        }
+
+        if (args.count("--record-baseline"))
+        {
+            write_baseline(args.at("--record-baseline"), current);
+            std::cout << std::endl
+                      << "baseline recorded: " << args.at("--record-baseline") << std::endl;
+        }
+        if (failures)
+        {
+            std::cerr << std::endl
+                      << "baseline check failed: " << failures << " differences or regressions" << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
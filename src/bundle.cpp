@@ -0,0 +1,60 @@
+#include "apriltag_ros/bundle.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+Bundle bundle_config(const std::string &name,
+                     const apriltag_family_t *tf,
+                     const std::vector<int64_t> &ids,
+                     const std::vector<double> &poses)
+{
+    if (ids.empty())
+    {
+        throw std::runtime_error("Bundle " + name + " has no tags!");
+    }
+
+    if (7 * ids.size() != poses.size())
+    {
+        throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and poses (" + std::to_string(poses.size()) + " values) of bundle " + name + " mismatch, expected 7 values per tag!");
+    }
+
+    Bundle bundle;
+    bundle.name = name;
+    bundle.family = tf;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (ids[i] < 0 || ids[i] >= int64_t(tf->ncodes))
+        {
+            throw std::runtime_error("Tag id " + std::to_string(ids[i]) + " of bundle " + name + " is not in family " + tf->name);
+        }
+
+        const double *v = &poses[7 * i];
+        bundle.members[ids[i]] = {Eigen::Vector3d(v[0], v[1], v[2]), Eigen::Quaterniond(v[3], v[4], v[5], v[6]).normalized()};
+    }
+
+    return bundle;
+}
+
+Pose getBundlePose(const Poses &initial,
+                   const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                   const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                   const Mat3 &P,
+                   const int iterations)
+{
+    // the initial pose from the member that explains all corners best
+    Pose pose = initial.front();
+    double error = std::numeric_limits<double>::infinity();
+    for (const Pose &candidate : initial)
+    {
+        const double e = reprojection_error(candidate, X, x, P);
+        if (e < error)
+        {
+            pose = candidate;
+            error = e;
+        }
+    }
+
+    refinePose(pose, X, x, P, iterations);
+
+    return pose;
+}
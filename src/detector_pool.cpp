@@ -0,0 +1,270 @@
+#include "apriltag_ros/detector_pool.hpp"
+#include "apriltag_ros/tracing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+Histogram *Metrics::stage(const std::string &name)
+{
+    const auto find = [this, &name](const size_t n) -> Histogram * {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (stage_names[i] == name)
+                return &stages[i];
+        }
+        return nullptr;
+    };
+
+    // the published names are immutable and found without the lock
+    Histogram *histogram = find(stages_named);
+    if (histogram)
+        return histogram;
+
+    std::lock_guard<std::mutex> lock(mutex_stages);
+    const size_t n = stages_named;
+    histogram = find(n);
+    if (histogram || n == nstages)
+        return histogram;
+    stage_names[n] = name;
+    stages_named = n + 1;
+    return &stages[n];
+}
+
+DetectorPool::DetectorPool(std::shared_ptr<const DetectorConfig> config,
+                           const size_t size,
+                           const size_t streams,
+                           const bool drop_frames,
+                           Callback callback)
+    : config(std::move(config)),
+      drop_frames(drop_frames),
+      callback(std::move(callback)),
+      parameters(std::make_shared<const DetectorParameters>(default_parameters())),
+      running(true),
+      stream_next(0)
+{
+    if (size < 1)
+    {
+        throw std::runtime_error("Detector pool size (" + std::to_string(size) + ") must be positive!");
+    }
+
+    if (streams < 1)
+    {
+        throw std::runtime_error("Number of image streams (" + std::to_string(streams) + ") must be positive!");
+    }
+
+    for (size_t i = 0; i < streams; i++)
+    {
+        this->streams.emplace_back(new Stream(this->config->families));
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        workers.emplace_back(new Worker(this->config));
+    }
+
+    for (const std::unique_ptr<Worker> &worker : workers)
+    {
+        worker->thread = std::thread(&DetectorPool::work, this, std::ref(*worker));
+    }
+}
+
+DetectorPool::~DetectorPool()
+{
+    mutex_frame.lock();
+    running = false;
+    mutex_frame.unlock();
+    cv_frame.notify_all();
+
+    for (const std::unique_ptr<Worker> &worker : workers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    for (const std::unique_ptr<Stream> &stream : streams)
+    {
+        delete stream->pending.exchange(nullptr);
+    }
+}
+
+void DetectorPool::push(std::unique_ptr<Frame> frame)
+{
+    if (frame->stream >= streams.size())
+    {
+        throw std::runtime_error("Invalid image stream: " + std::to_string(frame->stream));
+    }
+    Stream &stream = *streams[frame->stream];
+
+    if (drop_frames)
+    {
+        stream.mutex_publish.lock();
+        frame->seq = stream.seq_next++;
+        stream.in_flight.insert(frame->seq);
+        stream.mutex_publish.unlock();
+
+        // replace the frame that is still waiting for a detector
+        const std::unique_ptr<Frame> dropped(stream.pending.exchange(frame.release()));
+        if (dropped)
+        {
+            stream.mutex_publish.lock();
+            stream.in_flight.erase(dropped->seq);
+            stream.mutex_publish.unlock();
+            stream.cv_publish.notify_all();
+
+            metric.frames_dropped++;
+        }
+
+        // synchronise with workers that are about to wait
+        mutex_frame.lock();
+        mutex_frame.unlock();
+    }
+    else
+    {
+        // wait until a worker took the previous frame
+        std::unique_lock<std::mutex> lock(mutex_frame);
+        cv_frame.wait(lock, [this, &stream] { return !stream.pending || !running; });
+        if (!running)
+            return;
+
+        stream.mutex_publish.lock();
+        frame->seq = stream.seq_next++;
+        stream.in_flight.insert(frame->seq);
+        stream.mutex_publish.unlock();
+
+        stream.pending = frame.release();
+    }
+
+    cv_frame.notify_all();
+}
+
+void DetectorPool::configure(const std::function<void(DetectorParameters &)> &f)
+{
+    std::lock_guard<std::mutex> lock(mutex_parameters);
+    std::shared_ptr<DetectorParameters> next = std::make_shared<DetectorParameters>(*std::atomic_load(&parameters));
+    f(*next);
+    std::atomic_store(&parameters, std::shared_ptr<const DetectorParameters>(std::move(next)));
+}
+
+Metrics &
+DetectorPool::metrics()
+{
+    return metric;
+}
+
+Frame *DetectorPool::take()
+{
+    // start after the stream of the last frame so that no stream starves
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        const size_t s = (stream_next + i) % streams.size();
+        Frame *frame = streams[s]->pending.exchange(nullptr);
+        if (frame)
+        {
+            stream_next = s + 1;
+            return frame;
+        }
+    }
+    return nullptr;
+}
+
+void DetectorPool::work(Worker &worker)
+{
+    const auto waiting = [this] {
+        return std::any_of(streams.begin(), streams.end(), [](const std::unique_ptr<Stream> &stream) { return stream->pending != nullptr; });
+    };
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(mutex_frame);
+        cv_frame.wait(lock, [this, &waiting] { return waiting() || !running; });
+        if (!running)
+            break;
+
+        const std::unique_ptr<Frame> current(take());
+        lock.unlock();
+        // the slot is free for the next frame
+        cv_frame.notify_all();
+
+        if (current)
+            process(worker, *current);
+    }
+}
+
+void DetectorPool::process(Worker &worker, const Frame &frame)
+{
+    typedef std::chrono::steady_clock clock;
+
+    Stream &stream = *streams[frame.stream];
+    // a single snapshot of the settings for all steps of the frame
+    const std::shared_ptr<const Settings> snapshot = config->settings();
+    const Settings &settings = *snapshot;
+
+    // latest parameters, with the decimation of this stream
+    DetectorParameters parameters = *std::atomic_load(&this->parameters);
+    const bool adaptive = settings.adaptive;
+    if (adaptive)
+    {
+        std::lock_guard<std::mutex> lock(stream.mutex_adaptive);
+        AdaptiveDecimation &state = stream.adaptive;
+        if (!state.decimate)
+        {
+            state.decimate = parameters.quad_decimate;
+            state.threads = parameters.nthreads;
+        }
+        parameters.quad_decimate = state.decimate;
+        if (settings.adaptive_threads > 0)
+            parameters.nthreads = state.threads;
+        metric.decimate.add(state.decimate);
+    }
+    else
+    {
+        // restart from the detector parameters when enabled again
+        std::lock_guard<std::mutex> lock(stream.mutex_adaptive);
+        stream.adaptive = AdaptiveDecimation();
+    }
+    worker.detector.configure(parameters, snapshot);
+
+    APRILTAG_ROS_TRACE_FRAME(frame.stamp, frame.frame_id.c_str());
+
+    Detections &detections = worker.detector.detect(frame.encoding, frame.data, frame.width, frame.height, frame.step, *frame.intrinsics, &stream.tracking, frame.stamp);
+
+    // pass on the detections after all earlier frames of the stream have been passed on
+    std::unique_lock<std::mutex> lock(stream.mutex_publish);
+    stream.cv_publish.wait(lock, [&stream, &frame] { return *stream.in_flight.begin() == frame.seq; });
+
+    // keep the tags for the next frame and filter their poses in order
+    stream.tracking.update(detections.tags, frame.stamp, settings);
+
+    if (adaptive)
+    {
+        std::lock_guard<std::mutex> lock_adaptive(stream.mutex_adaptive);
+        stream.adaptive.update(worker.detector.timings().detection, detections.tags, settings);
+    }
+
+    const clock::time_point t_publish = clock::now();
+    callback(frame, detections);
+    metric.publish.add(std::chrono::duration<double>(clock::now() - t_publish).count());
+
+    stream.in_flight.erase(frame.seq);
+    lock.unlock();
+    stream.cv_publish.notify_all();
+
+    const TagDetector &detector = worker.detector;
+    const Timings &timings = detector.timings();
+    metric.conversion.add(timings.conversion);
+    metric.detection.add(timings.detection);
+    for (const Stage &stage : timings.stages)
+    {
+        Histogram *histogram = metric.stage(stage.name);
+        if (histogram)
+            histogram->add(stage.duration);
+    }
+    metric.pose[size_t(timings.estimator)].add(timings.pose);
+    metric.detections.add(detections.tags.size());
+    // only the frames that are converted, e.g. not mono8 images
+    const size_t scratch = detector.scratch();
+    if (scratch)
+        metric.scratch.add(double(scratch));
+    metric.frames_processed++;
+}
@@ -0,0 +1,103 @@
+#include "apriltag_ros/filter.hpp"
+
+#include <Eigen/Geometry>
+#include <algorithm>
+
+namespace {
+
+Eigen::Quaterniond rotation_exp(const Eigen::Vector3d &v)
+{
+    const double angle = v.norm();
+    return angle > 0 ? Eigen::Quaterniond(Eigen::AngleAxisd(angle, v / angle)) : Eigen::Quaterniond::Identity();
+}
+
+Eigen::Vector3d rotation_log(Eigen::Quaterniond q)
+{
+    // shortest rotation
+    if (q.w() < 0)
+        q.coeffs() *= -1;
+    const Eigen::AngleAxisd aa(q);
+    return aa.angle() * aa.axis();
+}
+
+double seconds(const int64_t from, const int64_t to)
+{
+    return std::max<int64_t>(to - from, 0) * 1e-9;
+}
+
+// prediction of the covariance of value and rate with white acceleration noise
+void predict_covariance(Eigen::Matrix2d &covariance, const double dt, const double q)
+{
+    Eigen::Matrix2d F;
+    F << 1, dt,
+        0, 1;
+    Eigen::Matrix2d Q;
+    Q << dt * dt * dt / 3, dt * dt / 2,
+        dt * dt / 2, dt;
+    covariance = F * covariance * F.transpose() + q * Q;
+}
+
+// gain for a measurement of the value with variance 'r' and update of the covariance
+Eigen::Vector2d correct_covariance(Eigen::Matrix2d &covariance, const double r)
+{
+    const Eigen::Vector2d K = covariance.col(0) / (covariance(0, 0) + r);
+    covariance -= K * covariance.row(0);
+    return K;
+}
+
+} // namespace
+
+bool PoseFilter::active(const int64_t time, const double timeout) const
+{
+    return stamp >= 0 && seconds(stamp, time) <= timeout;
+}
+
+Pose PoseFilter::predict(const int64_t time) const
+{
+    const double dt = seconds(stamp, time);
+    return {position + velocity * dt, rotation_exp(angular_velocity * dt) * rotation};
+}
+
+Pose PoseFilter::update(const Pose &measurement,
+                        const int64_t time,
+                        const double timeout,
+                        const double process_noise,
+                        const double measurement_noise)
+{
+    if (!active(time, timeout))
+    {
+        // start from the measurement at rest with the variance of the
+        // measurement and of a velocity of 1 m/s or rad/s
+        stamp = time;
+        position = measurement.translation;
+        velocity.setZero();
+        rotation = measurement.rotation;
+        angular_velocity.setZero();
+        covariance_translation << measurement_noise, 0,
+            0, 1;
+        covariance_rotation = covariance_translation;
+        return measurement;
+    }
+
+    const double dt = seconds(stamp, time);
+    stamp = std::max(stamp, time);
+
+    // predict
+    position += velocity * dt;
+    rotation = rotation_exp(angular_velocity * dt) * rotation;
+    predict_covariance(covariance_translation, dt, process_noise);
+    predict_covariance(covariance_rotation, dt, process_noise);
+
+    // correct
+    const Eigen::Vector3d dp = measurement.translation - position;
+    const Eigen::Vector2d Kt = correct_covariance(covariance_translation, measurement_noise);
+    position += Kt[0] * dp;
+    velocity += Kt[1] * dp;
+
+    const Eigen::Vector3d dr = rotation_log(measurement.rotation * rotation.conjugate());
+    const Eigen::Vector2d Kr = correct_covariance(covariance_rotation, measurement_noise);
+    rotation = (rotation_exp(Kr[0] * dr) * rotation).normalized();
+    angular_velocity += Kr[1] * dr;
+
+    return {position, rotation};
+}
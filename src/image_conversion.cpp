@@ -0,0 +1,138 @@
+#include "apriltag_ros/image_conversion.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+enum class Layout
+{
+    None,
+    Planar,   // mono8 or luminance plane first (NV21, NV24)
+    Packed,   // interleaved luminance (YUV 4:2:2)
+    Bayer,    // colour filter array of any pattern
+    RGB,
+    BGR,
+};
+
+struct Format
+{
+    Layout layout;
+    int channels; // bytes per pixel
+    int offset;   // offset of the luminance byte in a pixel
+};
+
+Format format(const std::string &encoding)
+{
+    if (encoding == "mono8" || encoding == "8UC1" || encoding == "nv21" || encoding == "nv24")
+        return {Layout::Planar, 1, 0};
+    // UYVY
+    if (encoding == "yuv422" || encoding == "uyvy")
+        return {Layout::Packed, 2, 1};
+    // YUYV
+    if (encoding == "yuv422_yuy2" || encoding == "yuyv")
+        return {Layout::Packed, 2, 0};
+    if (encoding == "bayer_rggb8" || encoding == "bayer_bggr8" || encoding == "bayer_gbrg8" || encoding == "bayer_grbg8")
+        return {Layout::Bayer, 1, 0};
+    if (encoding == "rgb8")
+        return {Layout::RGB, 3, 0};
+    if (encoding == "rgba8")
+        return {Layout::RGB, 4, 0};
+    if (encoding == "bgr8")
+        return {Layout::BGR, 3, 0};
+    if (encoding == "bgra8")
+        return {Layout::BGR, 4, 0};
+    return {Layout::None, 0, 0};
+}
+
+// ITU-R BT.601 luma in 8 bit fixed point
+inline uint8_t luma(const uint8_t r, const uint8_t g, const uint8_t b)
+{
+    return uint8_t((77 * r + 150 * g + 29 * b) >> 8);
+}
+
+} // namespace
+
+bool can_convert_mono8(const std::string &encoding)
+{
+    return format(encoding).layout != Layout::None;
+}
+
+int bytes_per_pixel(const std::string &encoding)
+{
+    return format(encoding).channels;
+}
+
+bool valid_image(const std::string &encoding,
+                 const uint32_t width,
+                 const uint32_t height,
+                 const uint32_t step,
+                 const size_t size)
+{
+    // the detector addresses rows by 'int'
+    if (width > uint32_t(std::numeric_limits<int>::max()) || height > uint32_t(std::numeric_limits<int>::max()) || step > uint32_t(std::numeric_limits<int>::max()))
+        return false;
+    return uint64_t(step) >= uint64_t(width) * uint64_t(bytes_per_pixel(encoding)) && uint64_t(size) >= uint64_t(step) * uint64_t(height);
+}
+
+image_u8_t convert_mono8(const std::string &encoding,
+                         const uint8_t *data,
+                         const int width,
+                         const int height,
+                         const int step,
+                         std::vector<uint8_t> &buffer)
+{
+    const Format f = format(encoding);
+
+    if (f.layout == Layout::None)
+    {
+        throw std::runtime_error("Unsupported image encoding: " + encoding);
+    }
+
+    if (f.layout == Layout::Planar)
+    {
+        // the detector only reads from the image
+        return {width, height, step, const_cast<uint8_t *>(data)};
+    }
+
+    buffer.resize(size_t(width) * size_t(height));
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t *src = data + size_t(y) * step;
+        uint8_t *dst = buffer.data() + size_t(y) * width;
+
+        switch (f.layout)
+        {
+        case Layout::Packed:
+            for (int x = 0; x < width; x++)
+                dst[x] = src[f.channels * x + f.offset];
+            break;
+        case Layout::Bayer:
+        {
+            // Every 2x2 block of the colour filter array contains one red, two
+            // green and one blue pixel, such that the block average approximates
+            // the luminance (R + 2G + B) / 4 independent of the pattern.
+            const uint8_t *below = (y + 1 < height) ? src + step : (y > 0 ? src - step : src);
+            for (int x = 0; x < width; x++)
+            {
+                const int xn = (x + 1 < width) ? x + 1 : (x > 0 ? x - 1 : x);
+                dst[x] = uint8_t((src[x] + src[xn] + below[x] + below[xn] + 2) >> 2);
+            }
+            break;
+        }
+        case Layout::RGB:
+            for (int x = 0; x < width; x++)
+                dst[x] = luma(src[f.channels * x], src[f.channels * x + 1], src[f.channels * x + 2]);
+            break;
+        case Layout::BGR:
+            for (int x = 0; x < width; x++)
+                dst[x] = luma(src[f.channels * x + 2], src[f.channels * x + 1], src[f.channels * x]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return {width, height, width, buffer.data()};
+}
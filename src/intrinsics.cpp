@@ -0,0 +1,101 @@
+#include "apriltag_ros/intrinsics.hpp"
+
+#include <Eigen/LU>
+#include <algorithm>
+
+namespace {
+
+// 64 bit FNV-1a
+uint64_t fnv1a(const void *data, const size_t size, uint64_t hash = 0xcbf29ce484222325)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+} // namespace
+
+typedef Eigen::Array<double, 1, Eigen::Dynamic> Row;
+
+void undistort(Eigen::Ref<Eigen::Matrix2Xd> pixels, const Intrinsics &intrinsics)
+{
+    const Mat3 &K = intrinsics.P;
+    const std::array<double, 8> &d = intrinsics.d;
+
+    // distorted normalised coordinates
+    const Row yd = (pixels.row(1).array() - K(1, 2)) / K(1, 1);
+    const Row xd = (pixels.row(0).array() - K(0, 2) - K(0, 1) * yd) / K(0, 0);
+
+    // fixed-point iteration as in OpenCV 'undistortPoints'
+    Row x = xd, y = yd;
+    for (int i = 0; i < 10; i++)
+    {
+        const Row r2 = x.square() + y.square();
+        const Row icdist = (1 + ((d[7] * r2 + d[6]) * r2 + d[5]) * r2) / (1 + ((d[4] * r2 + d[1]) * r2 + d[0]) * r2);
+        const Row dx = 2 * d[2] * x * y + d[3] * (r2 + 2 * x.square());
+        const Row dy = d[2] * (r2 + 2 * y.square()) + 2 * d[3] * x * y;
+        x = (xd - dx) * icdist;
+        y = (yd - dy) * icdist;
+    }
+
+    pixels.row(0) = (K(0, 0) * x + K(0, 1) * y + K(0, 2)).matrix();
+    pixels.row(1) = (K(1, 1) * y + K(1, 2)).matrix();
+}
+
+void distort(Eigen::Ref<Eigen::Matrix2Xd> pixels, const Intrinsics &intrinsics)
+{
+    const Mat3 &K = intrinsics.P;
+    const std::array<double, 8> &d = intrinsics.d;
+
+    // undistorted normalised coordinates
+    const Row y = (pixels.row(1).array() - K(1, 2)) / K(1, 1);
+    const Row x = (pixels.row(0).array() - K(0, 2) - K(0, 1) * y) / K(0, 0);
+
+    const Row r2 = x.square() + y.square();
+    const Row radial = (1 + ((d[4] * r2 + d[1]) * r2 + d[0]) * r2) / (1 + ((d[7] * r2 + d[6]) * r2 + d[5]) * r2);
+    const Row xd = x * radial + 2 * d[2] * x * y + d[3] * (r2 + 2 * x.square());
+    const Row yd = y * radial + d[2] * (r2 + 2 * y.square()) + 2 * d[3] * x * y;
+
+    pixels.row(0) = (K(0, 0) * xd + K(0, 1) * yd + K(0, 2)).matrix();
+    pixels.row(1) = (K(1, 1) * yd + K(1, 2)).matrix();
+}
+
+std::shared_ptr<const Intrinsics>
+IntrinsicsCache::get(const std::array<double, 12> &p,
+                     const std::array<double, 9> &k,
+                     const std::vector<double> &d,
+                     const bool undistort)
+{
+    uint64_t h = fnv1a(p.data(), sizeof(double) * p.size());
+    h = fnv1a(k.data(), sizeof(double) * k.size(), h);
+    h = fnv1a(d.data(), sizeof(double) * d.size(), h);
+    h = fnv1a(&undistort, sizeof(undistort), h);
+
+    if (intrinsics && h == hash)
+    {
+        return intrinsics;
+    }
+
+    std::shared_ptr<Intrinsics> updated = std::make_shared<Intrinsics>();
+    updated->d.fill(0);
+    if (undistort)
+    {
+        updated->P = Eigen::Map<const Mat3>(k.data());
+        std::copy_n(d.begin(), std::min(d.size(), updated->d.size()), updated->d.begin());
+    }
+    else
+    {
+        updated->P = Eigen::Map<const Eigen::Matrix<double, 3, 4, Eigen::RowMajor>>(p.data()).leftCols<3>();
+    }
+    updated->Pinv = updated->P.inverse();
+    updated->distorted = std::any_of(updated->d.begin(), updated->d.end(), [](const double c) { return c != 0; });
+
+    hash = h;
+    intrinsics = updated;
+
+    return intrinsics;
+}
@@ -0,0 +1,77 @@
+#include "apriltag_ros/metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr size_t Histogram::nbins;
+constexpr double Histogram::bins_per_octave;
+
+Histogram::Histogram(const double resolution)
+    : resolution(resolution),
+      count(0),
+      sum(0),
+      min(std::numeric_limits<double>::infinity()),
+      max(0)
+{
+    for (std::atomic<uint64_t> &bin : bins)
+    {
+        bin = 0;
+    }
+}
+
+void Histogram::add(const double value)
+{
+    const double bin = (value > resolution) ? std::ceil(bins_per_octave * std::log2(value / resolution)) : 0;
+    bins[std::min(size_t(bin), nbins - 1)]++;
+    count++;
+
+    double current = sum;
+    while (!sum.compare_exchange_weak(current, current + value)) {}
+
+    current = min;
+    while (value < current && !min.compare_exchange_weak(current, value)) {}
+
+    current = max;
+    while (value > current && !max.compare_exchange_weak(current, value)) {}
+}
+
+Histogram::Summary Histogram::collect()
+{
+    Summary summary;
+
+    std::array<uint64_t, nbins> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < nbins; i++)
+    {
+        counts[i] = bins[i].exchange(0);
+        total += counts[i];
+    }
+
+    summary.count = count.exchange(0);
+    const double s = sum.exchange(0);
+    summary.min = min.exchange(std::numeric_limits<double>::infinity());
+    summary.max = max.exchange(0);
+
+    if (!summary.count)
+    {
+        return {0, 0, 0, 0, 0};
+    }
+
+    summary.mean = s / summary.count;
+
+    // upper bound of the bin containing the 99th percentile
+    uint64_t cumulative = 0;
+    summary.p99 = summary.max;
+    for (size_t i = 0; i < nbins; i++)
+    {
+        cumulative += counts[i];
+        if (cumulative >= std::ceil(0.99 * total))
+        {
+            summary.p99 = std::min(summary.max, resolution * std::exp2(i / bins_per_octave));
+            break;
+        }
+    }
+
+    return summary;
+}
@@ -0,0 +1,263 @@
+#include "apriltag_ros/pose.hpp"
+
+#include <apriltag_pose.h>
+
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+#include <stdexcept>
+
+PoseEstimator pose_estimator(const std::string &name)
+{
+    if (name == "homography")
+        return PoseEstimator::Homography;
+    if (name == "orthogonal_iteration")
+        return PoseEstimator::OrthogonalIteration;
+    if (name == "lm")
+        return PoseEstimator::LevenbergMarquardt;
+
+    throw std::runtime_error("Unsupported pose estimator: " + name);
+}
+
+const char *pose_estimator_name(const PoseEstimator estimator)
+{
+    switch (estimator)
+    {
+    case PoseEstimator::Homography:
+        return "homography";
+    case PoseEstimator::OrthogonalIteration:
+        return "orthogonal_iteration";
+    case PoseEstimator::LevenbergMarquardt:
+        return "lm";
+    }
+    return "";
+}
+
+Pose getPose(const matd_t &H,
+             const Mat3 &Pinv,
+             const double size)
+{
+    // compute extrinsic camera parameter
+    // https://dsp.stackexchange.com/a/2737/31703
+    // H = K * T  =>  T = K^(-1) * H
+    const Mat3 T = Pinv * Eigen::Map<const Mat3>(H.data);
+    Mat3 R;
+    R.col(0) = T.col(0).normalized();
+    R.col(1) = T.col(1).normalized();
+    R.col(2) = R.col(0).cross(R.col(1));
+
+    // the corner coordinates of the tag in the canonical frame are (+/-1, +/-1)
+    // hence the scale is half of the edge size
+    const Eigen::Vector3d tt = T.rightCols<1>() / ((T.col(0).norm() + T.col(1).norm()) / 2.0) * (size / 2.0);
+
+    // the normalised columns are not exactly orthogonal
+    return {tt, Eigen::Quaterniond(R).normalized()};
+}
+
+Pose getPoseOrthogonalIteration(apriltag_detection_t *det,
+                                const Mat3 &P,
+                                const double size)
+{
+    apriltag_detection_info_t info;
+    info.det = det;
+    info.tagsize = size;
+    info.fx = P(0, 0);
+    info.fy = P(1, 1);
+    info.cx = P(0, 2);
+    info.cy = P(1, 2);
+
+    apriltag_pose_t pose;
+    estimate_tag_pose(&info, &pose);
+
+    const Mat3 R = Eigen::Map<const Mat3>(pose.R->data);
+    const Eigen::Vector3d t = Eigen::Map<const Eigen::Vector3d>(pose.t->data);
+
+    matd_destroy(pose.R);
+    matd_destroy(pose.t);
+
+    return {t, Eigen::Quaterniond(R).normalized()};
+}
+
+Eigen::Matrix<double, 3, 4> tag_corners(const double size, const bool z_up)
+{
+    const double s = size / 2;
+    const double sy = z_up ? -s : s;
+    Eigen::Matrix<double, 3, 4> X;
+    X << -s, s, s, -s,
+        sy, sy, -sy, -sy,
+        0, 0, 0, 0;
+    return X;
+}
+
+Mat3 tag_homography(const double p[4][2])
+{
+    static const double tag[4][2] = {{-1, 1}, {1, 1}, {1, -1}, {-1, -1}};
+
+    // direct linear transformation with h33 = 1
+    Eigen::Matrix<double, 8, 8> A;
+    Eigen::Matrix<double, 8, 1> b;
+    for (size_t i = 0; i < 4; i++)
+    {
+        const double X = tag[i][0], Y = tag[i][1];
+        const double u = p[i][0], v = p[i][1];
+        A.row(2 * i) << X, Y, 1, 0, 0, 0, -u * X, -u * Y;
+        A.row(2 * i + 1) << 0, 0, 0, X, Y, 1, -v * X, -v * Y;
+        b.segment<2>(2 * i) << u, v;
+    }
+    const Eigen::Matrix<double, 8, 1> h = A.partialPivLu().solve(b);
+
+    Mat3 H;
+    H << h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1;
+    return H;
+}
+
+std::array<double, 8> project_corners(const Pose &pose, const double size, const bool z_up, const Mat3 &P)
+{
+    const Eigen::Matrix<double, 3, 4> X = tag_corners(size, z_up);
+    const Mat3 R = pose.rotation.toRotationMatrix();
+
+    std::array<double, 8> corners;
+    for (Eigen::Index i = 0; i < 4; i++)
+    {
+        const Eigen::Vector3d a = P * (R * X.col(i) + pose.translation);
+        corners[2 * i] = a.x() / a.z();
+        corners[2 * i + 1] = a.y() / a.z();
+    }
+    return corners;
+}
+
+double reprojection_error(const Pose &pose,
+                          const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                          const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                          const Mat3 &P)
+{
+    const Mat3 R = pose.rotation.toRotationMatrix();
+
+    double error = 0;
+    for (Eigen::Index i = 0; i < X.cols(); i++)
+    {
+        const Eigen::Vector3d a = P * (R * X.col(i) + pose.translation);
+        error += (a.head<2>() / a.z() - x.col(i)).squaredNorm();
+    }
+    return error;
+}
+
+double reprojection_error(const Pose &pose,
+                          const double p[4][2],
+                          const Mat3 &P,
+                          const double size)
+{
+    return reprojection_error(pose, tag_corners(size), Eigen::Map<const Eigen::Matrix<double, 2, 4>>(&p[0][0]), P);
+}
+
+void refinePose(Pose &pose,
+                const Eigen::Ref<const Eigen::Matrix3Xd> &X,
+                const Eigen::Ref<const Eigen::Matrix2Xd> &x,
+                const Mat3 &P,
+                const int iterations)
+{
+    typedef Eigen::Matrix<double, 6, 6> Mat6;
+    typedef Eigen::Matrix<double, 6, 1> Vec6;
+
+    Mat3 R = pose.rotation.toRotationMatrix();
+    Eigen::Vector3d t = pose.translation;
+
+    // residuals and normal equations of the reprojection error
+    const auto linearise = [&X, &x, &P](const Mat3 &R, const Eigen::Vector3d &t, Mat6 *JtJ, Vec6 *Jtr) {
+        double error = 0;
+        if (JtJ)
+        {
+            JtJ->setZero();
+            Jtr->setZero();
+        }
+        for (Eigen::Index i = 0; i < X.cols(); i++)
+        {
+            const Eigen::Vector3d RX = R * X.col(i);
+            const Eigen::Vector3d a = P * (RX + t);
+            const Eigen::Vector2d r = a.head<2>() / a.z() - x.col(i);
+            error += r.squaredNorm();
+
+            if (!JtJ)
+                continue;
+
+            // derivative of the projection by the point in the camera frame
+            Eigen::Matrix<double, 2, 3> da;
+            da << 1 / a.z(), 0, -a.x() / (a.z() * a.z()),
+                0, 1 / a.z(), -a.y() / (a.z() * a.z());
+            const Eigen::Matrix<double, 2, 3> dX = da * P;
+
+            // left perturbation of the rotation and translation
+            Mat3 skew;
+            skew << 0, -RX.z(), RX.y(),
+                RX.z(), 0, -RX.x(),
+                -RX.y(), RX.x(), 0;
+            Eigen::Matrix<double, 2, 6> J;
+            J.leftCols<3>() = -dX * skew;
+            J.rightCols<3>() = dX;
+
+            *JtJ += J.transpose() * J;
+            *Jtr += J.transpose() * r;
+        }
+        return error;
+    };
+
+    Mat6 JtJ;
+    Vec6 Jtr;
+    double error = linearise(R, t, &JtJ, &Jtr);
+    double lambda = 1e-3;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        Mat6 A = JtJ;
+        A.diagonal() *= 1 + lambda;
+        const Vec6 delta = -A.ldlt().solve(Jtr);
+
+        const double angle = delta.head<3>().norm();
+        const Mat3 R_new = (angle > 0 ? Eigen::AngleAxisd(angle, delta.head<3>() / angle).toRotationMatrix() : Mat3::Identity()) * R;
+        const Eigen::Vector3d t_new = t + delta.tail<3>();
+
+        const double error_new = linearise(R_new, t_new, nullptr, nullptr);
+        if (error_new < error)
+        {
+            R = R_new;
+            t = t_new;
+            error = linearise(R, t, &JtJ, &Jtr);
+            lambda /= 10;
+        }
+        else
+        {
+            lambda *= 10;
+        }
+
+        if (delta.squaredNorm() < 1e-16)
+            break;
+    }
+
+    pose.translation = t;
+    pose.rotation = Eigen::Quaterniond(R).normalized();
+}
+
+void refinePose(Pose &pose,
+                const double p[4][2],
+                const Mat3 &P,
+                const double size,
+                const int iterations)
+{
+    refinePose(pose, tag_corners(size), Eigen::Map<const Eigen::Matrix<double, 2, 4>>(&p[0][0]), P, iterations);
+}
+
+Pose rotate_z_up(const Pose &pose)
+{
+    // half rotation about x-axis
+    return {pose.translation, pose.rotation * Eigen::Quaterniond(0, 1, 0, 0)};
+}
+
+Pose operator*(const Pose &a, const Pose &b)
+{
+    return {a.translation + a.rotation * b.translation, a.rotation * b.rotation};
+}
+
+Pose inverse(const Pose &pose)
+{
+    const Eigen::Quaterniond q = pose.rotation.conjugate();
+    return {-(q * pose.translation), q};
+}
@@ -0,0 +1,140 @@
+#include "apriltag_ros/preprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef APRILTAG_ROS_CUDA
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/cudafilters.hpp>
+#include <opencv2/cudawarping.hpp>
+
+struct GpuPreprocessor::Buffers
+{
+    cv::cuda::Stream stream;
+    cv::cuda::GpuMat input;
+    cv::cuda::GpuMat decimated;
+    cv::cuda::GpuMat blurred;
+    // page-locked for asynchronous transfers
+    cv::cuda::HostMem output;
+    cv::Ptr<cv::cuda::Filter> filter;
+    float sigma = 0;
+};
+
+bool GpuPreprocessor::available()
+{
+    static const bool device = cv::cuda::getCudaEnabledDeviceCount() > 0;
+    return device;
+}
+
+GpuPreprocessor::GpuPreprocessor()
+    : buffers(new Buffers)
+{}
+
+image_u8_t GpuPreprocessor::process(const image_u8_t &im, const float decimate, const float sigma)
+{
+    Buffers &b = *buffers;
+
+    const cv::Mat host(im.height, im.width, CV_8UC1, im.buf, im.stride);
+    const float factor = decimation_factor(decimate);
+    if (factor == 1.5f)
+    {
+        // the library interpolates 3x3 to 2x2 pixels within the image
+        const cv::Size size(im.width / 3 * 2, im.height / 3 * 2);
+        b.input.upload(host, b.stream);
+        const cv::cuda::GpuMat input = b.input(cv::Rect(0, 0, size.width / 2 * 3, size.height / 2 * 3));
+        cv::cuda::resize(input, b.decimated, size, 1 / 1.5, 1 / 1.5, cv::INTER_AREA, b.stream);
+    }
+    else if (factor > 1)
+    {
+        // The library samples every n-th pixel with the output size
+        // 1 + (w - 1) / n. The input is padded to a multiple of that size,
+        // such that the scale is exactly n and the padding is never sampled.
+        const int n = int(factor);
+        const cv::Size size(1 + (im.width - 1) / n, 1 + (im.height - 1) / n);
+        b.input.create(size.height * n, size.width * n, CV_8UC1);
+        cv::cuda::GpuMat input = b.input(cv::Rect(0, 0, im.width, im.height));
+        input.upload(host, b.stream);
+        cv::cuda::resize(b.input, b.decimated, size, 1.0 / n, 1.0 / n, cv::INTER_NEAREST, b.stream);
+    }
+    else
+    {
+        b.input.upload(host, b.stream);
+    }
+    cv::cuda::GpuMat *current = factor > 1 ? &b.decimated : &b.input;
+
+    if (sigma > 0)
+    {
+        // same kernel size as the library, up to the maximum of OpenCV CUDA
+        if (!b.filter || b.sigma != sigma)
+        {
+            int ksz = std::min(int(4 * sigma), 31);
+            if ((ksz & 1) == 0)
+                ksz++;
+            b.filter = cv::cuda::createGaussianFilter(CV_8UC1, CV_8UC1, cv::Size(ksz, ksz), sigma);
+            b.sigma = sigma;
+        }
+        b.filter->apply(*current, b.blurred, b.stream);
+        current = &b.blurred;
+    }
+
+    current->download(b.output, b.stream);
+    b.stream.waitForCompletion();
+
+    const cv::Mat output = b.output.createMatHeader();
+    return {output.cols, output.rows, int(output.step), output.data};
+}
+#else
+struct GpuPreprocessor::Buffers
+{};
+
+bool GpuPreprocessor::available()
+{
+    return false;
+}
+
+GpuPreprocessor::GpuPreprocessor()
+{
+    throw std::runtime_error("Built without CUDA support!");
+}
+
+image_u8_t GpuPreprocessor::process(const image_u8_t &, const float, const float)
+{
+    throw std::runtime_error("Built without CUDA support!");
+}
+#endif
+
+GpuPreprocessor::~GpuPreprocessor() = default;
+
+float decimation_factor(const float decimate)
+{
+    if (decimate == 1.5f)
+        return 1.5f;
+    return std::max(1.0f, std::floor(decimate));
+}
+
+void rescale(zarray_t *detections, const float factor)
+{
+    // same transformation as the library applies to decimated quads
+    const double offset = (factor == 1.5f) ? 0 : 0.5 - 0.5 * factor;
+
+    for (int i = 0; i < zarray_size(detections); i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(detections, i, &det);
+
+        for (size_t k = 0; k < 2; k++)
+        {
+            det->c[k] = det->c[k] * factor + offset;
+            for (size_t c = 0; c < 4; c++)
+                det->p[c][k] = det->p[c][k] * factor + offset;
+        }
+
+        // H' = [f 0 o; 0 f o; 0 0 1] * H
+        for (size_t c = 0; c < 3; c++)
+        {
+            MATD_EL(det->H, 0, c) = factor * MATD_EL(det->H, 0, c) + offset * MATD_EL(det->H, 2, c);
+            MATD_EL(det->H, 1, c) = factor * MATD_EL(det->H, 1, c) + offset * MATD_EL(det->H, 2, c);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include "apriltag_ros/roi.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+Rect bounding_box(const std::array<double, 8> &corners, const double padding, const int width, const int height)
+{
+    double xmin = corners[0], xmax = corners[0];
+    double ymin = corners[1], ymax = corners[1];
+    for (size_t i = 1; i < 4; i++)
+    {
+        xmin = std::min(xmin, corners[2 * i]);
+        xmax = std::max(xmax, corners[2 * i]);
+        ymin = std::min(ymin, corners[2 * i + 1]);
+        ymax = std::max(ymax, corners[2 * i + 1]);
+    }
+
+    const double px = padding * (xmax - xmin);
+    const double py = padding * (ymax - ymin);
+
+    const int x0 = std::max(0, int(std::floor(xmin - px)));
+    const int y0 = std::max(0, int(std::floor(ymin - py)));
+    const int x1 = std::min(width, int(std::ceil(xmax + px)));
+    const int y1 = std::min(height, int(std::ceil(ymax + py)));
+
+    return {x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+}
+
+Rect clip(const Rect &rect, const int width, const int height)
+{
+    const int x0 = std::max(0, rect.x);
+    const int y0 = std::max(0, rect.y);
+    const int x1 = std::min(width, rect.x + rect.width);
+    const int y1 = std::min(height, rect.y + rect.height);
+
+    return {x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+}
+
+std::vector<Rect> regions(const std::vector<int64_t> &rects)
+{
+    if (rects.size() % 4)
+    {
+        throw std::runtime_error("Number of region values (" + std::to_string(rects.size()) + ") is not a multiple of 4 (x, y, width, height)!");
+    }
+
+    std::vector<Rect> regions;
+    for (size_t i = 0; i < rects.size(); i += 4)
+    {
+        const Rect rect{int(rects[i]), int(rects[i + 1]), int(rects[i + 2]), int(rects[i + 3])};
+        if (rect.x < 0 || rect.y < 0 || rect.width <= 0 || rect.height <= 0)
+        {
+            throw std::runtime_error("Region " + std::to_string(i / 4) + " is not a rectangle in the image!");
+        }
+        regions.push_back(rect);
+    }
+    merge_overlapping(regions);
+
+    return regions;
+}
+
+static bool overlap(const Rect &a, const Rect &b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width &&
+           a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+void merge_overlapping(std::vector<Rect> &rects)
+{
+    // merging can make a union overlap with a region that has already been
+    // checked, hence repeat until no regions overlap
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < rects.size(); j++)
+            {
+                if (overlap(rects[i], rects[j]))
+                {
+                    const int x0 = std::min(rects[i].x, rects[j].x);
+                    const int y0 = std::min(rects[i].y, rects[j].y);
+                    const int x1 = std::max(rects[i].x + rects[i].width, rects[j].x + rects[j].width);
+                    const int y1 = std::max(rects[i].y + rects[i].height, rects[j].y + rects[j].height);
+                    rects[i] = {x0, y0, x1 - x0, y1 - y0};
+                    rects.erase(rects.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+zarray_t *detect_region(apriltag_detector_t *td, const image_u8_t &im, const Rect &roi)
+{
+    // view into the original image buffer without copying
+    image_u8_t sub{roi.width, roi.height, im.stride, im.buf + roi.y * im.stride + roi.x};
+
+    zarray_t *detections = apriltag_detector_detect(td, &sub);
+
+    for (int i = 0; i < zarray_size(detections); i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(detections, i, &det);
+
+        det->c[0] += roi.x;
+        det->c[1] += roi.y;
+        for (size_t c = 0; c < 4; c++)
+        {
+            det->p[c][0] += roi.x;
+            det->p[c][1] += roi.y;
+        }
+
+        // H' = [1 0 x; 0 1 y; 0 0 1] * H
+        for (size_t c = 0; c < 3; c++)
+        {
+            MATD_EL(det->H, 0, c) += roi.x * MATD_EL(det->H, 2, c);
+            MATD_EL(det->H, 1, c) += roi.y * MATD_EL(det->H, 2, c);
+        }
+    }
+
+    return detections;
+}
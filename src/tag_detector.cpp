@@ -0,0 +1,684 @@
+#include "apriltag_ros/tag_detector.hpp"
+#include "apriltag_ros/image_conversion.hpp"
+#include "apriltag_ros/tracing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <common/workerpool.h>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+TagConfigs tag_config(const apriltag_family_t *tf,
+                      const std::vector<int64_t> &ids,
+                      const std::vector<std::string> &frames,
+                      const std::vector<double> &sizes,
+                      const double size)
+{
+    if (!frames.empty() && ids.size() != frames.size())
+    {
+        throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and frames (" + std::to_string(frames.size()) + ") mismatch!");
+    }
+
+    if (!sizes.empty() && ids.size() != sizes.size())
+    {
+        throw std::runtime_error("Number of tag ids (" + std::to_string(ids.size()) + ") and sizes (" + std::to_string(sizes.size()) + ") mismatch!");
+    }
+
+    // generic tag name and default size
+    TagConfigs tags;
+    tags.other = {frames.empty(), -1, size, -1};
+    if (tf->ncodes <= TagConfigs::max_dense)
+    {
+        tags.ids.assign(tf->ncodes, tags.other);
+        tags.frames.reserve(tf->ncodes + ids.size());
+        for (uint32_t id = 0; id < tf->ncodes; id++)
+        {
+            tags.ids[id].frame = int(id);
+            tags.frames.push_back(std::string(tf->name) + ":" + std::to_string(id));
+        }
+    }
+
+    // configured tag name and tag specific size
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (ids[i] < 0 || ids[i] >= int64_t(tf->ncodes))
+        {
+            throw std::runtime_error("Tag id " + std::to_string(ids[i]) + " is not in family " + tf->name);
+        }
+        TagConfig &tag = tags.add(int(ids[i]));
+        if (!frames.empty())
+        {
+            tag.enabled = true;
+            tag.frame = int(tags.frames.size());
+            tags.frames.push_back(frames[i]);
+        }
+        if (!sizes.empty())
+        {
+            tag.size = sizes[i];
+        }
+    }
+
+    return tags;
+}
+
+Tracking::Tracking(const TagFamilies &families)
+    : families(families),
+      tracks(families.get().size())
+{
+    previous.reserve(64);
+}
+
+const Track *Tracking::find(const apriltag_family_t *family, const int id) const
+{
+    return tracks[families.index(family)].find(id);
+}
+
+void Tracking::update(Detections::Tags &detections, const int64_t stamp, const Settings &settings)
+{
+    const bool filter = settings.filter;
+    const double timeout = settings.filter_timeout;
+    const double process_noise = settings.filter_process_noise;
+    const double measurement_noise = settings.filter_measurement_noise;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (Track *track : previous)
+        track->previous = false;
+    previous.clear();
+
+    for (Detection &detection : detections)
+    {
+        // tracks are never moved, the pointers in 'previous' are stable
+        Track &track = tracks[families.index(detection.family)].get(detection.id);
+        track.family = detection.family;
+        track.id = detection.id;
+        track.previous = true;
+        track.corners = detection.corners;
+        track.size = detection.size;
+        track.pose = detection.pose;
+        previous.push_back(&track);
+
+        if (filter)
+            detection.pose = track.filter.update(detection.pose, stamp, timeout, process_noise, measurement_noise);
+    }
+}
+
+static bool find_pose(Tracking &tracking, const apriltag_detection_t *det, Pose &pose)
+{
+    std::lock_guard<std::mutex> lock(tracking.mutex);
+    const Track *track = tracking.find(det->family, det->id);
+    if (!track || !track->previous)
+        return false;
+    pose = track->pose;
+    return true;
+}
+
+TagDetector::TagDetector(std::shared_ptr<const DetectorConfig> config)
+    : config(std::move(config)),
+      td(apriltag_detector_create()),
+      frames(this->config->families.get().size()),
+      timing{}
+{
+    this->config->families.add(td);
+}
+
+TagDetector::~TagDetector()
+{
+    config->families.remove(td);
+    apriltag_detector_destroy(td);
+}
+
+DetectorParameters default_parameters()
+{
+    apriltag_detector_t *const td = apriltag_detector_create();
+    const DetectorParameters parameters = {td->nthreads, td->quad_decimate, td->quad_sigma, td->refine_edges, td->decode_sharpening, td->debug};
+    apriltag_detector_destroy(td);
+    return parameters;
+}
+
+std::shared_ptr<const Settings> DetectorConfig::settings() const
+{
+    return std::atomic_load(&current);
+}
+
+void DetectorConfig::configure(const std::function<void(Settings &)> &f)
+{
+    std::lock_guard<std::mutex> lock(mutex_settings);
+    std::shared_ptr<Settings> next = std::make_shared<Settings>(*std::atomic_load(&current));
+    f(*next);
+    std::atomic_store(&current, std::shared_ptr<const Settings>(std::move(next)));
+}
+
+void TagDetector::configure(const DetectorParameters &parameters, std::shared_ptr<const Settings> settings)
+{
+    configured = std::move(settings);
+    td->nthreads = parameters.nthreads;
+    td->quad_decimate = parameters.quad_decimate;
+    td->quad_sigma = parameters.quad_sigma;
+    td->refine_edges = parameters.refine_edges;
+    td->decode_sharpening = parameters.decode_sharpening;
+    td->debug = parameters.debug;
+
+    // older versions of the library create the worker pool only once
+    if (td->wp && workerpool_get_nthreads(td->wp) != td->nthreads)
+    {
+        workerpool_destroy(td->wp);
+        td->wp = workerpool_create(td->nthreads);
+    }
+}
+
+Detections &
+TagDetector::detect(const std::string &encoding,
+                    const uint8_t *data,
+                    const int width,
+                    const int height,
+                    const int step,
+                    const Intrinsics &intrinsics,
+                    Tracking *tracking,
+                    const int64_t stamp)
+{
+    const std::chrono::steady_clock::time_point t_start = std::chrono::steady_clock::now();
+
+    // convert to 8bit monochrome image
+    const image_u8_t im = convert_mono8(encoding, data, width, height, step, converted);
+    nconverted = (im.buf == converted.data()) ? converted.size() : 0;
+    APRILTAG_ROS_TRACE_STAGE(conversion);
+
+    const double conversion = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+
+    detect_image(im, intrinsics, tracking, stamp);
+    timing.conversion = conversion;
+
+    return detections;
+}
+
+Detections &
+TagDetector::detect(const image_u8_t &im, const Intrinsics &intrinsics, Tracking *tracking, const int64_t stamp)
+{
+    nconverted = 0;
+    detect_image(im, intrinsics, tracking, stamp);
+    timing.conversion = 0;
+
+    return detections;
+}
+
+void TagDetector::detect_image(const image_u8_t &im, const Intrinsics &intrinsics, Tracking *tracking, const int64_t stamp)
+{
+    typedef std::chrono::steady_clock clock;
+    const auto seconds = [](const clock::time_point &start, const clock::time_point &end) {
+        return std::chrono::duration<double>(end - start).count();
+    };
+
+    // settings of this frame
+    snapshot = configured ? configured : config->settings();
+    const Settings &settings = *snapshot;
+
+    const clock::time_point t_start = clock::now();
+
+    // regions around the tags of the previous frame
+    rois.clear();
+    expected.clear();
+    if (tracking && settings.tracking)
+    {
+        const bool filter = settings.filter;
+        const double timeout = settings.filter_timeout;
+
+        std::lock_guard<std::mutex> lock(tracking->mutex);
+        if (!tracking->previous.empty() && tracking->frames_tracked < settings.tracking_interval)
+        {
+            for (const Track *track : tracking->previous)
+            {
+                expected.push_back(track);
+                std::array<double, 8> corners = track->corners;
+                if (filter && track->filter.active(stamp, timeout))
+                {
+                    // region at the predicted pose
+                    corners = project_corners(track->filter.predict(stamp), track->size, settings.z_up, intrinsics.P);
+                    if (intrinsics.distorted)
+                        distort(Eigen::Map<Eigen::Matrix<double, 2, 4>>(corners.data()), intrinsics);
+                }
+                const Rect roi = bounding_box(corners, settings.tracking_padding, im.width, im.height);
+                if (roi.width > 0 && roi.height > 0)
+                    rois.push_back(roi);
+            }
+            merge_overlapping(rois);
+            tracking->frames_tracked++;
+        }
+        else
+        {
+            // full-frame search
+            tracking->frames_tracked = 0;
+        }
+    }
+
+    timing.stages.clear();
+
+    // detect tags
+    for (const Rect &roi : rois)
+    {
+        results.push_back(detect_region(td, im, roi));
+        profile_stages();
+    }
+    accept();
+    const auto lost = [this](const Track *track) {
+        return std::none_of(dets.begin(), dets.end(), [track](const apriltag_detection_t *det) { return det->family == track->family && det->id == track->id; });
+    };
+    if (rois.empty() || std::any_of(expected.begin(), expected.end(), lost))
+    {
+        // full-frame search, or a tracked tag was lost
+        for (zarray_t *result : results)
+            apriltag_detections_destroy(result);
+        results.clear();
+        const bool pyramid = settings.pyramid;
+        if (config->regions.empty())
+        {
+            if (pyramid)
+            {
+                detect_pyramid(im, {0, 0, im.width, im.height});
+            }
+            else
+            {
+                results.push_back(detect_frame(im));
+                profile_stages();
+            }
+        }
+        for (const Rect &region : config->regions)
+        {
+            // only the static regions of interest
+            const Rect roi = clip(region, im.width, im.height);
+            if (roi.width > 0 && roi.height > 0)
+            {
+                if (pyramid)
+                {
+                    detect_pyramid(im, roi);
+                }
+                else
+                {
+                    results.push_back(detect_region(td, im, roi));
+                    profile_stages();
+                }
+            }
+        }
+        accept(pyramid);
+    }
+    if (settings.profile)
+        timeprofile_display(td->tp);
+
+    const clock::time_point t_detected = clock::now();
+    APRILTAG_ROS_TRACE_STAGE(detection);
+
+    // corners of all detections in the undistorted image
+    undistorted.resize(2, 4 * dets.size());
+    for (size_t i = 0; i < dets.size(); i++)
+        undistorted.middleCols<4>(4 * i) = Eigen::Map<const Eigen::Matrix<double, 2, 4>>(&dets[i]->p[0][0]);
+    if (intrinsics.distorted)
+        undistort(undistorted, intrinsics);
+
+    // resizing keeps the detections of the previous frame allocated
+    detections.tags.resize(dets.size());
+    const PoseTask base = {this, &intrinsics, tracking, settings.estimator, settings.z_up, settings.pose_iterations, 0, 0};
+    const PoseEstimator estimator = base.estimator;
+
+    // split dense scenes into ranges for the idle threads of the library,
+    // each detection is written to its own slot
+    const size_t nthreads = td->wp ? size_t(std::max(1, workerpool_get_nthreads(td->wp))) : 1;
+    const size_t ntasks = std::min(nthreads, dets.size() / min_detections_per_task);
+    if (ntasks > 1)
+    {
+        tasks.assign(ntasks, base);
+        for (size_t t = 0; t < ntasks; t++)
+        {
+            tasks[t].begin = dets.size() * t / ntasks;
+            tasks[t].end = dets.size() * (t + 1) / ntasks;
+            workerpool_add_task(td->wp, estimate_poses, &tasks[t]);
+        }
+        workerpool_run(td->wp);
+    }
+    else
+    {
+        PoseTask task = base;
+        task.end = dets.size();
+        estimate_poses(&task);
+    }
+
+    estimate_bundles(intrinsics);
+
+    const clock::time_point t_pose = clock::now();
+    APRILTAG_ROS_TRACE_STAGE(pose);
+
+    for (zarray_t *result : results)
+        apriltag_detections_destroy(result);
+    results.clear();
+
+    timing.detection = seconds(t_start, t_detected);
+    timing.pose = seconds(t_detected, t_pose);
+    timing.estimator = estimator;
+}
+
+void TagDetector::estimate_poses(void *p)
+{
+    const PoseTask &task = *static_cast<const PoseTask *>(p);
+    TagDetector &detector = *task.detector;
+    const DetectorConfig &config = *detector.config;
+    const Intrinsics &intrinsics = *task.intrinsics;
+    Tracking *tracking = task.tracking;
+    const bool z_up = task.z_up;
+    const PoseEstimator estimator = task.estimator;
+
+    for (size_t i = task.begin; i < task.end; i++)
+    {
+        apriltag_detection_t *det = detector.dets[i];
+        const TagConfigs &tags = config.tags[config.families.index(det->family)];
+        const TagConfig &tag = tags.get(det->id);
+
+        Detection &detection = detector.detections.tags[i];
+        detection.family = det->family;
+        detection.id = det->id;
+        detection.hamming = det->hamming;
+        detection.decision_margin = det->decision_margin;
+        std::memcpy(detection.centre.data(), det->c, sizeof(double) * 2);
+        std::memcpy(detection.corners.data(), det->p, sizeof(double) * 8);
+        std::memcpy(detection.homography.data(), det->H->data, sizeof(double) * 9);
+        detection.frame = (tag.frame >= 0) ? &tags.frames[tag.frame] : detector.frames[config.families.index(det->family)].find(det->id);
+        detection.size = tag.size;
+        detection.bundle = (tag.bundle >= 0) ? &config.bundles[tag.bundle] : nullptr;
+
+        // estimate the pose from the undistorted corners, the detection
+        // keeps the corners and homography in the image
+        if (intrinsics.distorted)
+        {
+            Eigen::Map<Eigen::Matrix<double, 2, 4>>(&det->p[0][0]) = detector.undistorted.middleCols<4>(4 * i);
+            Eigen::Map<Mat3>(det->H->data) = tag_homography(det->p);
+        }
+
+        // 3D orientation and position
+        Pose pose = getPose(*(det->H), intrinsics.Pinv, detection.size);
+        if (estimator == PoseEstimator::OrthogonalIteration)
+        {
+            pose = getPoseOrthogonalIteration(det, intrinsics.P, detection.size);
+        }
+        else if (estimator == PoseEstimator::LevenbergMarquardt)
+        {
+            // start from the pose in the previous frame if it fits better
+            Pose previous;
+            if (tracking && find_pose(*tracking, det, previous))
+            {
+                if (z_up)
+                    previous = rotate_z_up(previous);
+                if (reprojection_error(previous, det->p, intrinsics.P, detection.size) < reprojection_error(pose, det->p, intrinsics.P, detection.size))
+                    pose = previous;
+            }
+            refinePose(pose, det->p, intrinsics.P, detection.size, task.iterations);
+        }
+        detection.pose = z_up ? rotate_z_up(pose) : pose;
+    }
+}
+
+const Timings &
+TagDetector::timings() const
+{
+    return timing;
+}
+
+size_t
+TagDetector::scratch() const
+{
+    return nconverted;
+}
+
+zarray_t *TagDetector::detect_frame(const image_u8_t &im)
+{
+    const float decimate = td->quad_decimate;
+    const float sigma = td->quad_sigma;
+    const float factor = decimation_factor(decimate);
+
+    if (!snapshot->gpu || !(factor > 1 || sigma > 0) || !GpuPreprocessor::available())
+    {
+        image_u8_t full = im;
+        return apriltag_detector_detect(td, &full);
+    }
+
+    if (!gpu)
+        gpu.reset(new GpuPreprocessor);
+
+    // quad detection and decoding in the preprocessed image, a negative
+    // sigma still sharpens in the library
+    image_u8_t preprocessed = gpu->process(im, decimate, sigma);
+    td->quad_decimate = 1;
+    if (sigma > 0)
+        td->quad_sigma = 0;
+    zarray_t *detections = apriltag_detector_detect(td, &preprocessed);
+    td->quad_decimate = decimate;
+    td->quad_sigma = sigma;
+
+    rescale(detections, factor);
+
+    return detections;
+}
+
+// Bounding box of the part of 'core' that is not covered by the union of
+// 'boxes', empty if the core is covered completely.
+static Rect uncovered(const Rect &core, const std::vector<Rect> &boxes, std::vector<Rect> &overlapping, std::vector<int> &xs, std::vector<int> &ys)
+{
+    // the boxes split the core into cells, which are either covered or not
+    overlapping.clear();
+    xs.assign({core.x, core.x + core.width});
+    ys.assign({core.y, core.y + core.height});
+    for (const Rect &box : boxes)
+    {
+        const int x0 = std::max(core.x, box.x);
+        const int y0 = std::max(core.y, box.y);
+        const int x1 = std::min(core.x + core.width, box.x + box.width);
+        const int y1 = std::min(core.y + core.height, box.y + box.height);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+        overlapping.push_back({x0, y0, x1 - x0, y1 - y0});
+        xs.insert(xs.end(), {x0, x1});
+        ys.insert(ys.end(), {y0, y1});
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    int x0 = core.x + core.width, y0 = core.y + core.height, x1 = core.x, y1 = core.y;
+    for (size_t j = 0; j + 1 < ys.size(); j++)
+    {
+        for (size_t i = 0; i + 1 < xs.size(); i++)
+        {
+            const auto contains = [&xs, &ys, i, j](const Rect &r) {
+                return r.x <= xs[i] && xs[i + 1] <= r.x + r.width && r.y <= ys[j] && ys[j + 1] <= r.y + r.height;
+            };
+            if (std::any_of(overlapping.begin(), overlapping.end(), contains))
+                continue;
+            x0 = std::min(x0, xs[i]);
+            y0 = std::min(y0, ys[j]);
+            x1 = std::max(x1, xs[i + 1]);
+            y1 = std::max(y1, ys[j + 1]);
+        }
+    }
+    return {x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+}
+
+void TagDetector::detect_pyramid(const image_u8_t &im, const Rect &area)
+{
+    const Settings &settings = *snapshot;
+    const int tile = std::max(1, int(settings.pyramid_tile));
+
+    // coarse pass for large tags
+    const float decimate = td->quad_decimate;
+    td->quad_decimate = float(settings.pyramid_decimate);
+    zarray_t *coarse = detect_region(td, im, area);
+    td->quad_decimate = decimate;
+    results.push_back(coarse);
+    profile_stages();
+
+    // The tiles overlap by at least the largest edge of the tags that the
+    // coarse pass may miss, such that each of them is completely inside one
+    // of the tiles. The library finds tags down to an edge of about
+    // 'min_coarse_edge' pixels in the decimated image.
+    static constexpr double min_coarse_edge = 12;
+    const int overlap = std::max(int(settings.pyramid_overlap), int(std::ceil(min_coarse_edge * settings.pyramid_decimate)));
+
+    covered.clear();
+    for (int i = 0; i < zarray_size(coarse); i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(coarse, i, &det);
+        std::array<double, 8> corners;
+        std::memcpy(corners.data(), det->p, sizeof(double) * 8);
+        covered.push_back(bounding_box(corners, 0, im.width, im.height));
+    }
+
+    const auto intersect = [&area](const Rect &rect) {
+        const int x0 = std::max(area.x, rect.x);
+        const int y0 = std::max(area.y, rect.y);
+        const int x1 = std::min(area.x + area.width, rect.x + rect.width);
+        const int y1 = std::min(area.y + area.height, rect.y + rect.height);
+        return Rect{x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+    };
+
+    // Fine pass in the parts of the tiles that are not covered by the large
+    // tags, skipping the completely covered tiles.
+    for (int y = area.y; y < area.y + area.height; y += tile)
+    {
+        for (int x = area.x; x < area.x + area.width; x += tile)
+        {
+            const Rect core = uncovered(intersect({x, y, tile, tile}), covered, overlapping, xs, ys);
+            if (core.width <= 0 || core.height <= 0)
+                continue;
+
+            results.push_back(detect_region(td, im, intersect({core.x - overlap, core.y - overlap, core.width + 2 * overlap, core.height + 2 * overlap})));
+            profile_stages();
+        }
+    }
+}
+
+void TagDetector::accept(const bool deduplicate)
+{
+    const int max_hamming = snapshot->max_hamming;
+
+    dets.clear();
+    for (zarray_t *result : results)
+    {
+        // tags of the family
+        const apriltag_family_t *family = nullptr;
+        const TagConfigs *tags = nullptr;
+        IdTable<std::string> *names = nullptr;
+
+        for (int i = 0; i < zarray_size(result); i++)
+        {
+            apriltag_detection_t *det;
+            zarray_get(result, i, &det);
+
+            if (det->family != family)
+            {
+                family = det->family;
+                const size_t index = config->families.index(family);
+                tags = &config->tags[index];
+                names = &frames[index];
+            }
+
+            // ignore untracked tags and reject detections with more
+            // corrected bits than allowed
+            const TagConfig &tag = tags->get(det->id);
+            if (!tag.enabled || det->hamming > max_hamming)
+            {
+                continue;
+            }
+
+            // name the tag on its first detection, before the poses are
+            // estimated in parallel
+            if (tag.frame < 0)
+            {
+                std::string &name = names->get(det->id);
+                if (name.empty())
+                    name = std::string(family->name) + ":" + std::to_string(det->id);
+            }
+
+            if (deduplicate)
+            {
+                // the same tag if the centre is inside the other detection,
+                // keep the detection with the larger margin
+                const auto same = [det](const apriltag_detection_t *other) {
+                    if (other->family != det->family || other->id != det->id)
+                        return false;
+                    std::array<double, 8> corners;
+                    std::memcpy(corners.data(), other->p, sizeof(double) * 8);
+                    const Rect box = bounding_box(corners, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+                    return box.x <= det->c[0] && det->c[0] <= box.x + box.width && box.y <= det->c[1] && det->c[1] <= box.y + box.height;
+                };
+                const auto duplicate = std::find_if(dets.begin(), dets.end(), same);
+                if (duplicate != dets.end())
+                {
+                    if (det->decision_margin > (*duplicate)->decision_margin)
+                        *duplicate = det;
+                    continue;
+                }
+            }
+
+            dets.push_back(det);
+        }
+    }
+}
+
+void TagDetector::estimate_bundles(const Intrinsics &intrinsics)
+{
+    const bool z_up = snapshot->z_up;
+
+    detections.bundles.clear();
+    for (const Bundle &bundle : config->bundles)
+    {
+        size_t members = 0;
+        for (const Detection &detection : detections.tags)
+        {
+            if (detection.bundle == &bundle)
+                members++;
+        }
+        if (!members)
+            continue;
+
+        // corners of all detected members in the bundle frame
+        bundle_points.resize(3, 4 * members);
+        bundle_pixels.resize(2, 4 * members);
+        bundle_poses.clear();
+        size_t k = 0;
+        for (size_t i = 0; i < detections.tags.size(); i++)
+        {
+            const Detection &detection = detections.tags[i];
+            if (detection.bundle != &bundle)
+                continue;
+
+            const Pose &member = bundle.members.at(detection.id);
+            const Eigen::Matrix<double, 3, 4> corners = tag_corners(detection.size, z_up);
+            bundle_points.middleCols<4>(4 * k) = (member.rotation.toRotationMatrix() * corners).colwise() + member.translation;
+            bundle_pixels.middleCols<4>(4 * k) = undistorted.middleCols<4>(4 * i);
+
+            // bundle pose from the pose of this member
+            bundle_poses.push_back(detection.pose * inverse(member));
+            k++;
+        }
+
+        detections.bundles.push_back({&bundle, members, getBundlePose(bundle_poses, bundle_points, bundle_pixels, intrinsics.P, snapshot->pose_iterations)});
+    }
+}
+
+void TagDetector::profile_stages()
+{
+    const timeprofile_t *tp = td->tp;
+
+    int64_t utime = tp->utime;
+    for (int i = 0; i < zarray_size(tp->stamps); i++)
+    {
+        timeprofile_entry stamp;
+        zarray_get(tp->stamps, i, &stamp);
+        // the stamped stages differ between regions, e.g. the coarse and fine
+        // passes of the pyramid, and are accumulated by name
+        const auto it = std::find_if(timing.stages.begin(), timing.stages.end(), [&stamp](const Stage &stage) { return stage.name == stamp.name; });
+        Stage &stage = it != timing.stages.end() ? *it : (timing.stages.push_back({stamp.name, 0}), timing.stages.back());
+        stage.duration += (stamp.utime - utime) * 1e-6;
+        utime = stamp.utime;
+    }
+}
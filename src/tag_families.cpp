@@ -0,0 +1,122 @@
+#include "apriltag_ros/tag_families.hpp"
+#include "apriltag_ros/tag_functions.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+// entry of the registry of families
+struct TagFamilies::Family
+{
+    explicit Family(const std::string &name)
+        : owner(apriltag_detector_create()),
+          tf(tag_create.at(name)()),
+          destroy(tag_destroy.at(name))
+    {
+        // builds the quick-decode table
+        apriltag_detector_add_family(owner, tf);
+    }
+
+    ~Family()
+    {
+        // frees the quick-decode table
+        apriltag_detector_destroy(owner);
+        destroy(tf);
+    }
+
+    Family(const Family &) = delete;
+    Family &operator=(const Family &) = delete;
+
+    // Get the family 'name' from the registry, or create it if no instance is
+    // alive. The table of a family is built while holding the mutex, such that
+    // concurrently started nodes wait for a single build.
+    static std::shared_ptr<const Family> get(const std::string &name, bool &created)
+    {
+        static std::mutex mutex;
+        static std::map<std::string, std::weak_ptr<const Family>> registry;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<const Family> family = registry[name].lock();
+        created = !family;
+        if (created)
+        {
+            family = std::make_shared<const Family>(name);
+            registry[name] = family;
+        }
+        return family;
+    }
+
+    apriltag_detector_t *const owner;
+    apriltag_family_t *const tf;
+    void (*const destroy)(apriltag_family_t *);
+};
+
+TagFamilies::TagFamilies(const std::vector<std::string> &names)
+    : ncreated(0)
+{
+    if (names.empty())
+    {
+        throw std::runtime_error("No tag family selected!");
+    }
+
+    for (const std::string &name : names)
+    {
+        if (!tag_create.count(name))
+        {
+            throw std::runtime_error("Unsupported tag family: " + name);
+        }
+
+        if (std::count(names.begin(), names.end(), name) > 1)
+        {
+            throw std::runtime_error("Duplicate tag family: " + name);
+        }
+    }
+
+    for (const std::string &name : names)
+    {
+        bool create;
+        shared.push_back(Family::get(name, create));
+        families.push_back(shared.back()->tf);
+        ncreated += create;
+    }
+}
+
+TagFamilies::~TagFamilies()
+{
+    // the last instance of a family destroys it with its entry
+    families.clear();
+    shared.clear();
+}
+
+void TagFamilies::add(apriltag_detector_t *td) const
+{
+    for (apriltag_family_t *tf : families)
+    {
+        zarray_add(td->tag_families, &tf);
+    }
+}
+
+void TagFamilies::remove(apriltag_detector_t *td) const
+{
+    // 'apriltag_detector_destroy' would free the shared quick-decode tables
+    zarray_clear(td->tag_families);
+}
+
+const std::vector<apriltag_family_t *> &
+TagFamilies::get() const
+{
+    return families;
+}
+
+size_t
+TagFamilies::index(const apriltag_family_t *family) const
+{
+    return std::find(families.begin(), families.end(), family) - families.begin();
+}
+
+size_t
+TagFamilies::created() const
+{
+    return ncreated;
+}
@@ -1,4 +1,4 @@
-#include "tag_functions.hpp"
+#include "apriltag_ros/tag_functions.hpp"
 
 // default tag families
 #include <tag16h5.h>
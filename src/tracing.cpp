@@ -0,0 +1,12 @@
+#ifdef APRILTAG_ROS_TRACING
+// probes of the tracepoint provider, defined once in the core library before
+// the provider is included
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+#endif
+
+#include "apriltag_ros/tracing.hpp"
+
+#ifdef APRILTAG_ROS_TRACING
+thread_local TraceFrame trace_frame = {0, ""};
+#endif
@@ -0,0 +1,36 @@
+# Replay the synthetic set with the benchmark. The detections are compared with
+# the committed baseline 'BASELINE'. The throughput is compared with the machine
+# specific baseline 'MACHINE_BASELINE', which is recorded by the first run and
+# fails the test if the throughput dropped by more than 'MAX_REGRESSION'
+# percent. Remove it to record a new machine baseline.
+#
+# cmake -DBENCHMARK=<exe> -DRENDER=<exe> -DDIRECTORY=<dir> -DBASELINE=<csv>
+#       -DMACHINE_BASELINE=<csv> -DMAX_REGRESSION=<percent> -DREPEAT=<n>
+#       -P baseline.cmake
+
+file(MAKE_DIRECTORY ${DIRECTORY})
+execute_process(COMMAND ${RENDER} ${DIRECTORY} RESULT_VARIABLE result)
+if(result)
+  message(FATAL_ERROR "rendering the synthetic set failed")
+endif()
+
+set(replay ${BENCHMARK} --images ${DIRECTORY} --camera 500,500,320,240 --size 0.1
+    --corner-tolerance 1 --translation-tolerance 0.01 --rotation-tolerance 2)
+
+execute_process(COMMAND ${replay} --check-baseline ${BASELINE} RESULT_VARIABLE result)
+if(result)
+  message(FATAL_ERROR "the detections differ from ${BASELINE}")
+endif()
+
+if(NOT EXISTS ${MACHINE_BASELINE})
+  execute_process(COMMAND ${replay} --repeat ${REPEAT} --record-baseline ${MACHINE_BASELINE} RESULT_VARIABLE result)
+  if(result)
+    message(FATAL_ERROR "recording ${MACHINE_BASELINE} failed")
+  endif()
+  message(STATUS "recorded the throughput baseline ${MACHINE_BASELINE}")
+else()
+  execute_process(COMMAND ${replay} --repeat ${REPEAT} --check-baseline ${MACHINE_BASELINE} --max-regression ${MAX_REGRESSION} RESULT_VARIABLE result)
+  if(result)
+    message(FATAL_ERROR "the replay differs from or regressed by more than ${MAX_REGRESSION}% against ${MACHINE_BASELINE}")
+  endif()
+endif()
@@ -0,0 +1,39 @@
+// Render the images of the synthetic set into a directory, such that the
+// benchmark can replay them without storing image data in the repository.
+
+#include "apriltag_ros/tag_families.hpp"
+#include "synthetic.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "usage: render_synthetic <directory>" << std::endl;
+        return 1;
+    }
+
+    const TagFamilies families({"36h11"});
+    const apriltag_family_t *tf = families.get().front();
+
+    for (size_t i = 0; i < synthetic_set.size(); i++)
+    {
+        std::vector<uint8_t> image(size_t(synthetic_width) * synthetic_height, 255);
+        for (const SyntheticTag &tag : synthetic_set[i])
+            render(image, synthetic_width, tf, tag.id, tag.x0, tag.y0, tag.scale);
+
+        const std::string path = std::string(argv[1]) + "/synthetic_" + std::to_string(i) + ".png";
+        if (!cv::imwrite(path, cv::Mat(synthetic_height, synthetic_width, CV_8UC1, image.data())))
+        {
+            std::cerr << "cannot write " << path << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
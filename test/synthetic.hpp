@@ -0,0 +1,78 @@
+#pragma once
+
+#include <apriltag.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// tag rendered into a synthetic image, with the corners of its black border
+struct TagImage
+{
+    int id;
+    std::array<double, 8> corners;
+};
+
+// Render tag 'id' of family 'tf' from its code with 'scale' pixels per bit at
+// the top left pixel (x0, y0) of a mono8 image with 'width' pixels per row, in
+// the layout of 'apriltag_to_image' of the library such that no image files
+// are required.
+inline TagImage render(std::vector<uint8_t> &image, const int width, const apriltag_family_t *tf, const int id, const int x0, const int y0, const int scale)
+{
+    const int total = tf->total_width;
+    std::vector<uint8_t> bits(size_t(total) * total, 0);
+
+    // white border of one bit around the black border
+    const int white_width = tf->width_at_border + (tf->reversed_border ? 0 : 2);
+    const int white_start = (total - white_width) / 2;
+    const int white_end = white_start + white_width - 1;
+    for (int i = white_start; i <= white_end; i++)
+    {
+        bits[white_start * total + i] = 255;
+        bits[white_end * total + i] = 255;
+        bits[i * total + white_start] = 255;
+        bits[i * total + white_end] = 255;
+    }
+
+    // data bits, the most significant bit first
+    const int border_start = (total - tf->width_at_border) / 2;
+    const uint64_t code = tf->codes[id];
+    for (uint32_t i = 0; i < tf->nbits; i++)
+    {
+        if (code & (uint64_t(1) << (tf->nbits - i - 1)))
+            bits[(tf->bit_y[i] + border_start) * total + tf->bit_x[i] + border_start] = 255;
+    }
+
+    for (int y = 0; y < total * scale; y++)
+    {
+        for (int x = 0; x < total * scale; x++)
+            image[size_t(y0 + y) * width + x0 + x] = bits[(y / scale) * total + x / scale];
+    }
+
+    // the corners wrap counter-clockwise around the tag from the bottom left,
+    // pixel x covers the coordinates [x, x + 1)
+    const double left = x0 + scale * border_start;
+    const double right = x0 + scale * (border_start + tf->width_at_border);
+    const double top = y0 + scale * border_start;
+    const double bottom = y0 + scale * (border_start + tf->width_at_border);
+    return {id, {left, bottom, right, bottom, right, top, left, top}};
+}
+
+// placement of a tag in an image of the synthetic set
+struct SyntheticTag
+{
+    int id;
+    int x0;
+    int y0;
+    int scale;
+};
+
+// Images of 640x480 pixels with tags of the family 36h11 that are replayed
+// against 'test/baseline.csv'. The black borders are at least 128 pixels wide
+// such that the poses of the fronto-parallel tags are well conditioned.
+static const int synthetic_width = 640;
+static const int synthetic_height = 480;
+static const std::vector<std::vector<SyntheticTag>> synthetic_set = {
+    {{0, 40, 40, 20}, {586, 360, 200, 24}},
+    {{42, 220, 120, 24}},
+    {{7, 10, 10, 16}, {100, 240, 10, 16}, {300, 460, 10, 16}, {211, 120, 250, 20}, {512, 380, 260, 18}},
+};
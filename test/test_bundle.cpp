@@ -0,0 +1,59 @@
+#include "apriltag_ros/bundle.hpp"
+
+#include <gtest/gtest.h>
+
+static const double size = 0.1;
+
+TEST(Bundle, Pose)
+{
+    Mat3 P;
+    P << 600, 0, 320,
+        0, 600, 240,
+        0, 0, 1;
+
+    // 2x2 board of tags
+    const std::array<Eigen::Vector3d, 4> members = {Eigen::Vector3d(-0.06, -0.06, 0), Eigen::Vector3d(0.06, -0.06, 0), Eigen::Vector3d(0.06, 0.06, 0), Eigen::Vector3d(-0.06, 0.06, 0)};
+    const Pose truth = {Eigen::Vector3d(0.02, 0.01, 0.9), Eigen::Quaterniond(Eigen::AngleAxisd(0.4, Eigen::Vector3d(1, -1, 0.5).normalized()))};
+
+    Eigen::Matrix3Xd X(3, 4 * members.size());
+    Eigen::Matrix2Xd x(2, 4 * members.size());
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        X.middleCols<4>(4 * i) = tag_corners(size).colwise() + members[i];
+        for (int j = 0; j < 4; j++)
+        {
+            const Eigen::Vector3d pixel = P * (truth.rotation * X.col(4 * i + j) + truth.translation);
+            x.col(4 * i + j) = pixel.hnormalized();
+        }
+    }
+
+    // noisy estimates of the bundle pose from single members, the best of
+    // them is refined
+    Poses initial;
+    initial.push_back({truth.translation + Eigen::Vector3d(0.3, 0, 0), truth.rotation});
+    initial.push_back({truth.translation + Eigen::Vector3d(0.01, -0.01, 0.03), truth.rotation * Eigen::Quaterniond(Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitX()))});
+
+    const Pose pose = getBundlePose(initial, X, x, P, 20);
+    EXPECT_LT((pose.translation - truth.translation).norm(), 1e-6);
+    EXPECT_LT(pose.rotation.angularDistance(truth.rotation), 1e-6);
+    EXPECT_LT(reprojection_error(pose, X, x, P), 1e-9);
+}
+
+TEST(Bundle, Config)
+{
+    apriltag_family_t tf = {};
+    tf.ncodes = 10;
+    tf.name = const_cast<char *>("tag36h11");
+
+    const Bundle bundle = bundle_config("board", &tf, {1, 3}, {0, 0, 0, 1, 0, 0, 0, 0.1, 0, 0, 2, 0, 0, 0});
+    EXPECT_EQ(bundle.name, "board");
+    EXPECT_EQ(bundle.family, &tf);
+    ASSERT_EQ(bundle.members.size(), 2u);
+    EXPECT_TRUE(bundle.members.at(3).translation.isApprox(Eigen::Vector3d(0.1, 0, 0)));
+    // normalised rotation
+    EXPECT_TRUE(bundle.members.at(3).rotation.isApprox(Eigen::Quaterniond::Identity()));
+
+    EXPECT_THROW(bundle_config("board", &tf, {}, {}), std::runtime_error);
+    EXPECT_THROW(bundle_config("board", &tf, {1}, {0, 0, 0, 1, 0, 0}), std::runtime_error);
+    EXPECT_THROW(bundle_config("board", &tf, {10}, {0, 0, 0, 1, 0, 0, 0}), std::runtime_error);
+}
@@ -0,0 +1,73 @@
+#include "apriltag_ros/filter.hpp"
+
+#include <Eigen/Geometry>
+#include <gtest/gtest.h>
+
+static constexpr int64_t period = 33000000; // 30 Hz in nanoseconds
+
+// constant linear and angular velocity
+static Pose motion(const int64_t time)
+{
+    const double t = time * 1e-9;
+    return {Eigen::Vector3d(0.1 + 0.2 * t, -0.05 * t, 1.0), Eigen::Quaterniond(Eigen::AngleAxisd(0.5 * t, Eigen::Vector3d::UnitZ()))};
+}
+
+TEST(PoseFilter, FirstUpdate)
+{
+    PoseFilter filter;
+    EXPECT_FALSE(filter.active(0, 0.5));
+
+    const Pose measurement = motion(period);
+    const Pose pose = filter.update(measurement, period, 0.5, 0.1, 1e-4);
+    EXPECT_TRUE(pose.translation.isApprox(measurement.translation));
+    EXPECT_TRUE(filter.active(period, 0.5));
+    EXPECT_FALSE(filter.active(period + 1000000000, 0.5));
+}
+
+TEST(PoseFilter, ConstantVelocity)
+{
+    PoseFilter filter;
+    for (int i = 1; i <= 60; i++)
+        filter.update(motion(i * period), i * period, 0.5, 0.1, 1e-6);
+
+    EXPECT_NEAR(filter.velocity.x(), 0.2, 1e-2);
+    EXPECT_NEAR(filter.velocity.y(), -0.05, 1e-2);
+    EXPECT_NEAR(filter.angular_velocity.z(), 0.5, 1e-2);
+
+    // the prediction of the next frame follows the motion
+    const Pose predicted = filter.predict(61 * period);
+    const Pose truth = motion(61 * period);
+    EXPECT_LT((predicted.translation - truth.translation).norm(), 1e-3);
+    EXPECT_LT(predicted.rotation.angularDistance(truth.rotation), 1e-3);
+}
+
+TEST(PoseFilter, Smoothing)
+{
+    // alternating measurement errors are attenuated
+    PoseFilter filter;
+    const Eigen::Vector3d position(0, 0, 1);
+    double error = 0;
+    for (int i = 1; i <= 100; i++)
+    {
+        const Pose measurement = {position + Eigen::Vector3d(0, 0, (i % 2) ? 0.01 : -0.01), Eigen::Quaterniond::Identity()};
+        const Pose pose = filter.update(measurement, i * period, 0.5, 0.1, 1e-4);
+        if (i > 50)
+            error = std::max(error, std::abs(pose.translation.z() - 1));
+    }
+    EXPECT_LT(error, 0.005);
+}
+
+TEST(PoseFilter, Reset)
+{
+    PoseFilter filter;
+    for (int i = 1; i <= 10; i++)
+        filter.update(motion(i * period), i * period, 0.5, 0.1, 1e-4);
+
+    // after the timeout, the filter restarts at rest from the measurement
+    const int64_t time = 10 * period + 1000000000;
+    const Pose measurement = {Eigen::Vector3d(1, 2, 3), Eigen::Quaterniond::Identity()};
+    const Pose pose = filter.update(measurement, time, 0.5, 0.1, 1e-4);
+    EXPECT_TRUE(pose.translation.isApprox(measurement.translation));
+    EXPECT_TRUE(filter.velocity.isZero());
+    EXPECT_EQ(filter.stamp, time);
+}
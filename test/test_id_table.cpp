@@ -0,0 +1,31 @@
+#include "apriltag_ros/id_table.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(IdTable, Find)
+{
+    IdTable<int> table;
+    EXPECT_EQ(table.find(3), nullptr);
+    EXPECT_EQ(table.find(-1), nullptr);
+
+    table.get(3) = 7;
+    ASSERT_NE(table.find(3), nullptr);
+    EXPECT_EQ(*table.find(3), 7);
+    // smaller ids are not created by a larger id
+    EXPECT_EQ(table.find(2), nullptr);
+    EXPECT_EQ(table.find(4), nullptr);
+}
+
+TEST(IdTable, StableValues)
+{
+    IdTable<int> table;
+    int *first = &table.get(5);
+    *first = 1;
+
+    // the index grows with the ids, the values stay in place
+    for (int id = 0; id < 10000; id += 7)
+        table.get(id) = id;
+    EXPECT_EQ(&table.get(5), first);
+    EXPECT_EQ(*first, 1);
+    EXPECT_EQ(*table.find(9996), 9996);
+}
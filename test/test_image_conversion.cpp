@@ -0,0 +1,146 @@
+#include "apriltag_ros/image_conversion.hpp"
+
+#include <functional>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <vector>
+
+static const int width = 6;
+static const int height = 4;
+
+// image with 'channels' bytes per pixel and rows padded to 'step' bytes
+static std::vector<uint8_t> image(const int channels, const int step, const std::function<uint8_t(int x, int y, int c)> &value)
+{
+    std::vector<uint8_t> data(size_t(step) * height, 0xAA);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            for (int c = 0; c < channels; c++)
+                data[size_t(y) * step + channels * x + c] = value(x, y, c);
+        }
+    }
+    return data;
+}
+
+static uint8_t pixel(const image_u8_t &im, const int x, const int y)
+{
+    return im.buf[y * im.stride + x];
+}
+
+TEST(ImageConversion, Supported)
+{
+    for (const std::string encoding : {"mono8", "8UC1", "nv21", "nv24", "yuv422", "uyvy", "yuv422_yuy2", "yuyv", "bayer_rggb8", "bayer_bggr8", "bayer_gbrg8", "bayer_grbg8", "rgb8", "rgba8", "bgr8", "bgra8"})
+        EXPECT_TRUE(can_convert_mono8(encoding)) << encoding;
+    EXPECT_FALSE(can_convert_mono8("mono16"));
+
+    std::vector<uint8_t> buffer;
+    const uint8_t data[4] = {};
+    EXPECT_THROW(convert_mono8("mono16", data, 1, 1, 2, buffer), std::runtime_error);
+}
+
+TEST(ImageConversion, Mono8WithoutCopy)
+{
+    std::vector<uint8_t> buffer;
+    const std::vector<uint8_t> data = image(1, 8, [](int x, int y, int) { return uint8_t(10 * y + x); });
+    const image_u8_t im = convert_mono8("mono8", data.data(), width, height, 8, buffer);
+    EXPECT_EQ(im.buf, data.data());
+    EXPECT_EQ(im.stride, 8);
+    EXPECT_EQ(pixel(im, 5, 3), 35);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(ImageConversion, PackedYUV)
+{
+    std::vector<uint8_t> buffer_yuyv, buffer_uyvy;
+    // luminance in the even bytes of YUYV and the odd bytes of UYVY
+    const std::vector<uint8_t> yuyv = image(2, 16, [](int x, int y, int c) { return c == 0 ? uint8_t(10 * y + x) : 128; });
+    const image_u8_t im_yuyv = convert_mono8("yuyv", yuyv.data(), width, height, 16, buffer_yuyv);
+    const std::vector<uint8_t> uyvy = image(2, 12, [](int x, int y, int c) { return c == 1 ? uint8_t(10 * y + x) : 128; });
+    const image_u8_t im_uyvy = convert_mono8("uyvy", uyvy.data(), width, height, 12, buffer_uyvy);
+
+    EXPECT_EQ(im_yuyv.stride, width);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            EXPECT_EQ(pixel(im_yuyv, x, y), 10 * y + x);
+            EXPECT_EQ(pixel(im_uyvy, x, y), 10 * y + x);
+        }
+    }
+    EXPECT_EQ(buffer_yuyv.size(), size_t(width * height));
+}
+
+TEST(ImageConversion, RGB)
+{
+    std::vector<uint8_t> buffer;
+    const std::vector<uint8_t> rgb = image(3, 18, [](int, int, int c) { return c == 0 ? 255 : 0; });
+    const std::vector<uint8_t> bgra = image(4, 24, [](int, int, int c) { return c == 2 ? 255 : 0; });
+    const std::vector<uint8_t> white = image(3, 18, [](int, int, int) { return 255; });
+
+    // BT.601 luma of red
+    EXPECT_EQ(pixel(convert_mono8("rgb8", rgb.data(), width, height, 18, buffer), 2, 1), 76);
+    EXPECT_EQ(pixel(convert_mono8("bgra8", bgra.data(), width, height, 24, buffer), 2, 1), 76);
+    EXPECT_EQ(pixel(convert_mono8("bgr8", white.data(), width, height, 18, buffer), 5, 3), 255);
+}
+
+TEST(ImageConversion, Bayer)
+{
+    std::vector<uint8_t> buffer;
+    // RGGB pattern of a uniform colour, the 2x2 average is (R + 2G + B) / 4
+    const std::vector<uint8_t> rggb = image(1, 8, [](int x, int y, int) -> uint8_t {
+        if (y % 2 == 0)
+            return x % 2 == 0 ? 200 : 100;
+        return x % 2 == 0 ? 100 : 0;
+    });
+    for (const std::string encoding : {"bayer_rggb8", "bayer_gbrg8"})
+    {
+        const image_u8_t im = convert_mono8(encoding, rggb.data(), width, height, 8, buffer);
+        // including the last row and column, which are averaged with the
+        // previous ones
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+                EXPECT_EQ(pixel(im, x, y), 100) << encoding << " " << x << "," << y;
+        }
+    }
+}
+
+TEST(ImageConversion, ValidImage)
+{
+    EXPECT_EQ(bytes_per_pixel("mono8"), 1);
+    EXPECT_EQ(bytes_per_pixel("yuyv"), 2);
+    EXPECT_EQ(bytes_per_pixel("bgra8"), 4);
+    // the luminance plane of planar YUV
+    EXPECT_EQ(bytes_per_pixel("nv21"), 1);
+
+    EXPECT_TRUE(valid_image("rgb8", width, height, 18, 18 * height));
+    EXPECT_TRUE(valid_image("rgb8", width, height, 20, 20 * height + 3));
+    // truncated data and rows shorter than the pixels
+    EXPECT_FALSE(valid_image("rgb8", width, height, 18, 18 * height - 1));
+    EXPECT_FALSE(valid_image("rgb8", width, height, 17, 17 * height));
+    // only the luminance plane is read
+    EXPECT_TRUE(valid_image("nv21", width, height, width, size_t(width) * height));
+    EXPECT_FALSE(valid_image("mono8", 1u << 31, 1, 1u << 31, size_t(1) << 31));
+}
+
+TEST(ImageConversion, BufferReuse)
+{
+    std::vector<uint8_t> buffer;
+    const std::vector<uint8_t> rgb = image(3, 18, [](int x, int y, int) { return uint8_t(10 * y + x); });
+    const uint8_t *data = convert_mono8("rgb8", rgb.data(), width, height, 18, buffer).buf;
+    EXPECT_EQ(data, buffer.data());
+    const size_t capacity = buffer.capacity();
+
+    // the next frames convert into the same memory
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_EQ(convert_mono8("rgb8", rgb.data(), width, height, 18, buffer).buf, data);
+        EXPECT_EQ(buffer.capacity(), capacity);
+    }
+
+    // a smaller image keeps the capacity
+    convert_mono8("rgb8", rgb.data(), width, height / 2, 18, buffer);
+    EXPECT_EQ(buffer.data(), data);
+    EXPECT_EQ(buffer.capacity(), capacity);
+}
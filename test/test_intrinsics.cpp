@@ -0,0 +1,84 @@
+#include "apriltag_ros/intrinsics.hpp"
+
+#include <gtest/gtest.h>
+
+static const std::array<double, 12> p = {500, 0, 320, 0, 0, 500, 240, 0, 0, 0, 1, 0};
+static const std::array<double, 9> k = {510, 0, 322, 0, 505, 238, 0, 0, 1};
+static const std::vector<double> d = {-0.25, 0.08, 1e-3, -5e-4, -0.01};
+
+// grid of pixels over the image, within the region of a valid distortion model
+static Eigen::Matrix2Xd grid()
+{
+    Eigen::Matrix2Xd pixels(2, 13 * 10);
+    for (int y = 0; y < 10; y++)
+    {
+        for (int x = 0; x < 13; x++)
+            pixels.col(y * 13 + x) << 20 + 50 * x, 15 + 50 * y;
+    }
+    return pixels;
+}
+
+TEST(Intrinsics, Rectified)
+{
+    IntrinsicsCache cache;
+    const std::shared_ptr<const Intrinsics> intrinsics = cache.get(p, k, d);
+    EXPECT_FALSE(intrinsics->distorted);
+    EXPECT_DOUBLE_EQ(intrinsics->P(0, 0), 500);
+    EXPECT_DOUBLE_EQ(intrinsics->P(1, 2), 240);
+    EXPECT_TRUE((intrinsics->P * intrinsics->Pinv).isIdentity(1e-12));
+}
+
+TEST(Intrinsics, Unrectified)
+{
+    IntrinsicsCache cache;
+    const std::shared_ptr<const Intrinsics> intrinsics = cache.get(p, k, d, true);
+    EXPECT_TRUE(intrinsics->distorted);
+    EXPECT_DOUBLE_EQ(intrinsics->P(0, 0), 510);
+    EXPECT_DOUBLE_EQ(intrinsics->d[0], -0.25);
+    // the rational coefficients of the plumb bob model are zero
+    EXPECT_EQ(intrinsics->d[5], 0);
+}
+
+TEST(Intrinsics, Cache)
+{
+    IntrinsicsCache cache;
+    const std::shared_ptr<const Intrinsics> first = cache.get(p, k, d);
+    EXPECT_EQ(cache.get(p, k, d), first);
+    EXPECT_NE(cache.get(p, k, d, true), first);
+
+    std::array<double, 12> q = p;
+    q[2] = 321;
+    EXPECT_DOUBLE_EQ(cache.get(q, k, d)->P(0, 2), 321);
+}
+
+TEST(Intrinsics, RoundTrip)
+{
+    IntrinsicsCache cache;
+    const Intrinsics &intrinsics = *cache.get(p, k, d, true);
+
+    const Eigen::Matrix2Xd pixels = grid();
+
+    Eigen::Matrix2Xd points = pixels;
+    undistort(points, intrinsics);
+    // the distortion moves the pixels away from the centre
+    EXPECT_GT((points - pixels).cwiseAbs().maxCoeff(), 1);
+    distort(points, intrinsics);
+    EXPECT_LT((points - pixels).cwiseAbs().maxCoeff(), 1e-3);
+
+    points = pixels;
+    distort(points, intrinsics);
+    undistort(points, intrinsics);
+    EXPECT_LT((points - pixels).cwiseAbs().maxCoeff(), 1e-3);
+}
+
+TEST(Intrinsics, RationalRoundTrip)
+{
+    IntrinsicsCache cache;
+    const Intrinsics &intrinsics = *cache.get(p, k, {-0.1, 0.01, 0, 0, 0, 0.05, 0.005, 0}, true);
+
+    const Eigen::Matrix2Xd pixels = grid();
+    Eigen::Matrix2Xd points = pixels;
+    undistort(points, intrinsics);
+    distort(points, intrinsics);
+    EXPECT_LT((points - pixels).cwiseAbs().maxCoeff(), 1e-3);
+}
@@ -0,0 +1,67 @@
+#include "apriltag_ros/metrics.hpp"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+TEST(Histogram, Summary)
+{
+    Histogram histogram;
+    for (int i = 0; i < 99; i++)
+        histogram.add(1e-3);
+    histogram.add(1e-1);
+
+    const Histogram::Summary summary = histogram.collect();
+    EXPECT_EQ(summary.count, 100u);
+    EXPECT_DOUBLE_EQ(summary.min, 1e-3);
+    EXPECT_DOUBLE_EQ(summary.max, 1e-1);
+    EXPECT_NEAR(summary.mean, (99 * 1e-3 + 1e-1) / 100, 1e-12);
+    // upper bound of the bin of the 99th value with a relative width of 19%
+    EXPECT_GE(summary.p99, 1e-3);
+    EXPECT_LE(summary.p99, 1e-3 * 1.19);
+}
+
+TEST(Histogram, CollectResets)
+{
+    Histogram histogram;
+    histogram.add(0.5);
+    EXPECT_EQ(histogram.collect().count, 1u);
+
+    const Histogram::Summary summary = histogram.collect();
+    EXPECT_EQ(summary.count, 0u);
+    EXPECT_EQ(summary.min, 0);
+    EXPECT_EQ(summary.max, 0);
+
+    histogram.add(2);
+    EXPECT_DOUBLE_EQ(histogram.collect().min, 2);
+}
+
+TEST(Histogram, Resolution)
+{
+    // values below the resolution are counted in the first bin
+    Histogram histogram(1);
+    histogram.add(0);
+    histogram.add(0.5);
+    const Histogram::Summary summary = histogram.collect();
+    EXPECT_EQ(summary.count, 2u);
+    EXPECT_DOUBLE_EQ(summary.p99, 0.5);
+}
+
+TEST(Histogram, Concurrent)
+{
+    Histogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&histogram] {
+            for (int i = 0; i < 10000; i++)
+                histogram.add(1e-3);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    const Histogram::Summary summary = histogram.collect();
+    EXPECT_EQ(summary.count, 40000u);
+    EXPECT_NEAR(summary.mean, 1e-3, 1e-12);
+}
@@ -0,0 +1,131 @@
+#include "apriltag_ros/pose.hpp"
+
+#include <gtest/gtest.h>
+
+static const double size = 0.162;
+
+static Mat3 camera()
+{
+    Mat3 P;
+    P << 500, 0, 320,
+        0, 500, 240,
+        0, 0, 1;
+    return P;
+}
+
+// tag in front of the camera, slightly rotated about all axes
+static Pose truth()
+{
+    const Eigen::Quaterniond rotation = Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitX()) *
+                                        Eigen::AngleAxisd(-0.2, Eigen::Vector3d::UnitY()) *
+                                        Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitZ());
+    return {Eigen::Vector3d(0.05, -0.03, 0.8), rotation};
+}
+
+static void expect_pose(const Pose &pose, const Pose &expected, const double tolerance)
+{
+    EXPECT_LT((pose.translation - expected.translation).norm(), tolerance);
+    EXPECT_LT(pose.rotation.angularDistance(expected.rotation), tolerance);
+}
+
+static void corners(const Pose &pose, double p[4][2])
+{
+    const std::array<double, 8> c = project_corners(pose, size, false, camera());
+    for (int i = 0; i < 4; i++)
+    {
+        p[i][0] = c[2 * i];
+        p[i][1] = c[2 * i + 1];
+    }
+}
+
+TEST(Pose, ProjectCorners)
+{
+    const Pose pose = truth();
+    const Eigen::Matrix<double, 3, 4> X = tag_corners(size);
+    const std::array<double, 8> c = project_corners(pose, size, false, camera());
+    for (int i = 0; i < 4; i++)
+    {
+        const Eigen::Vector3d x = camera() * (pose.rotation * X.col(i) + pose.translation);
+        EXPECT_NEAR(c[2 * i], x.x() / x.z(), 1e-9);
+        EXPECT_NEAR(c[2 * i + 1], x.y() / x.z(), 1e-9);
+    }
+
+    // the corners keep their pixels with the z axis pointing up
+    const std::array<double, 8> c_up = project_corners(rotate_z_up(pose), size, true, camera());
+    for (size_t i = 0; i < 8; i++)
+        EXPECT_NEAR(c_up[i], c[i], 1e-9);
+}
+
+TEST(Pose, Homography)
+{
+    double p[4][2];
+    corners(truth(), p);
+    const Mat3 H = tag_homography(p);
+
+    const double tag[4][2] = {{-1, 1}, {1, 1}, {1, -1}, {-1, -1}};
+    for (int i = 0; i < 4; i++)
+    {
+        const Eigen::Vector3d x = H * Eigen::Vector3d(tag[i][0], tag[i][1], 1);
+        EXPECT_NEAR(x.x() / x.z(), p[i][0], 1e-6);
+        EXPECT_NEAR(x.y() / x.z(), p[i][1], 1e-6);
+    }
+}
+
+TEST(Pose, DecomposeHomography)
+{
+    double p[4][2];
+    corners(truth(), p);
+    const Mat3 H = tag_homography(p);
+
+    matd_t *h = matd_create(3, 3);
+    Eigen::Map<Mat3>(h->data) = H;
+    const Pose pose = getPose(*h, camera().inverse(), size);
+    matd_destroy(h);
+
+    expect_pose(pose, truth(), 1e-6);
+}
+
+TEST(Pose, Refine)
+{
+    double p[4][2];
+    corners(truth(), p);
+
+    Pose pose = truth();
+    pose.translation += Eigen::Vector3d(0.02, -0.01, 0.05);
+    pose.rotation = pose.rotation * Eigen::Quaterniond(Eigen::AngleAxisd(0.1, Eigen::Vector3d(1, 1, 0).normalized()));
+    EXPECT_GT(reprojection_error(pose, p, camera(), size), 1);
+
+    refinePose(pose, p, camera(), size, 20);
+    expect_pose(pose, truth(), 1e-6);
+    EXPECT_LT(reprojection_error(pose, p, camera(), size), 1e-9);
+}
+
+TEST(Pose, RefineWithoutIterations)
+{
+    double p[4][2];
+    corners(truth(), p);
+
+    Pose pose = truth();
+    pose.translation.z() += 0.1;
+    const Pose initial = pose;
+    refinePose(pose, p, camera(), size, 0);
+    expect_pose(pose, initial, 1e-12);
+}
+
+TEST(Pose, Composition)
+{
+    const Pose a = truth();
+    const Pose b = {Eigen::Vector3d(1, 2, 3), Eigen::Quaterniond(Eigen::AngleAxisd(1, Eigen::Vector3d::UnitY()))};
+    const Pose c = {Eigen::Vector3d(-1, 0, 0.5), Eigen::Quaterniond(Eigen::AngleAxisd(-0.4, Eigen::Vector3d::UnitX()))};
+
+    expect_pose((a * b) * c, a * (b * c), 1e-12);
+    expect_pose(inverse(a) * a, {Eigen::Vector3d::Zero(), Eigen::Quaterniond::Identity()}, 1e-12);
+    expect_pose(rotate_z_up(rotate_z_up(a)), a, 1e-12);
+}
+
+TEST(Pose, Estimator)
+{
+    for (const PoseEstimator estimator : {PoseEstimator::Homography, PoseEstimator::OrthogonalIteration, PoseEstimator::LevenbergMarquardt})
+        EXPECT_EQ(pose_estimator(pose_estimator_name(estimator)), estimator);
+    EXPECT_THROW(pose_estimator("pnp"), std::runtime_error);
+}
@@ -0,0 +1,64 @@
+#include "apriltag_ros/roi.hpp"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+static void expect_rect(const Rect &rect, const int x, const int y, const int width, const int height)
+{
+    EXPECT_EQ(rect.x, x);
+    EXPECT_EQ(rect.y, y);
+    EXPECT_EQ(rect.width, width);
+    EXPECT_EQ(rect.height, height);
+}
+
+TEST(Roi, BoundingBox)
+{
+    const std::array<double, 8> corners = {10.5, 30, 30, 30, 30, 10.2, 10.5, 10.2};
+    expect_rect(bounding_box(corners, 0, 640, 480), 10, 10, 20, 20);
+    // padded by half the size on each side and clipped to the image
+    expect_rect(bounding_box(corners, 0.5, 35, 480), 0, 0, 35, 40);
+}
+
+TEST(Roi, Clip)
+{
+    expect_rect(clip({-10, 5, 30, 30}, 640, 480), 0, 5, 20, 30);
+    expect_rect(clip({630, 470, 30, 30}, 640, 480), 630, 470, 10, 10);
+    expect_rect(clip({700, 0, 30, 30}, 640, 480), 700, 0, 0, 30);
+}
+
+TEST(Roi, MergeOverlapping)
+{
+    std::vector<Rect> rects = {{0, 0, 10, 10}, {5, 5, 10, 10}, {100, 100, 10, 10}};
+    merge_overlapping(rects);
+    ASSERT_EQ(rects.size(), 2u);
+    expect_rect(rects[0], 0, 0, 15, 15);
+    expect_rect(rects[1], 100, 100, 10, 10);
+}
+
+TEST(Roi, MergeChain)
+{
+    // the union of the first and the last region overlaps the second region,
+    // which overlaps neither of them
+    std::vector<Rect> rects = {{0, 0, 10, 10}, {0, 15, 5, 5}, {8, 8, 10, 10}};
+    merge_overlapping(rects);
+    ASSERT_EQ(rects.size(), 1u);
+    expect_rect(rects[0], 0, 0, 18, 20);
+}
+
+TEST(Roi, TouchingRegionsAreKept)
+{
+    std::vector<Rect> rects = {{0, 0, 10, 10}, {10, 0, 10, 10}};
+    merge_overlapping(rects);
+    EXPECT_EQ(rects.size(), 2u);
+}
+
+TEST(Roi, Regions)
+{
+    const std::vector<Rect> rects = regions({0, 0, 10, 10, 5, 5, 10, 10});
+    ASSERT_EQ(rects.size(), 1u);
+    expect_rect(rects[0], 0, 0, 15, 15);
+
+    EXPECT_THROW(regions({0, 0, 10}), std::runtime_error);
+    EXPECT_THROW(regions({-1, 0, 10, 10}), std::runtime_error);
+    EXPECT_THROW(regions({0, 0, 0, 10}), std::runtime_error);
+}
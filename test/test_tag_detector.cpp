@@ -0,0 +1,251 @@
+#include "apriltag_ros/tag_detector.hpp"
+#include "synthetic.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <set>
+
+static const int width = 640;
+static const int height = 480;
+static const double size = 0.162;
+
+class TagDetectorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        config = std::make_shared<DetectorConfig>(std::vector<std::string>{"36h11"});
+        tf = config->families.get().front();
+        config->tags.push_back(tag_config(tf, {}, {}, {}, size));
+
+        const std::array<double, 12> p = {500, 0, 320, 0, 0, 500, 240, 0, 0, 0, 1, 0};
+        intrinsics = IntrinsicsCache().get(p, {500, 0, 320, 0, 500, 240, 0, 0, 1}, {});
+
+        image.assign(size_t(width) * height, 255);
+        tags.push_back(render(image, width, tf, 0, 40, 40, 6));
+        tags.push_back(render(image, width, tf, 7, 400, 60, 6));
+        tags.push_back(render(image, width, tf, 42, 100, 300, 8));
+        tags.push_back(render(image, width, tf, 586, 450, 320, 10));
+    }
+
+    const Detections &detect(TagDetector &detector, const DetectorParameters &parameters, Tracking *tracking = nullptr)
+    {
+        detector.configure(parameters);
+        return detector.detect("mono8", image.data(), width, height, width, *intrinsics, tracking);
+    }
+
+    const TagImage &tag(const int id) const
+    {
+        return *std::find_if(tags.begin(), tags.end(), [id](const TagImage &t) { return t.id == id; });
+    }
+
+    // every rendered tag is detected exactly once at its corners
+    void expect_tags(const Detections &detections, const double tolerance = 1.0) const
+    {
+        ASSERT_EQ(detections.tags.size(), tags.size());
+        for (const TagImage &tag : tags)
+        {
+            const auto it = std::find_if(detections.tags.begin(), detections.tags.end(), [&tag](const Detection &detection) { return detection.id == tag.id; });
+            ASSERT_NE(it, detections.tags.end()) << "tag " << tag.id;
+            EXPECT_EQ(it->family, tf);
+            EXPECT_EQ(it->hamming, 0);
+            for (size_t i = 0; i < 8; i++)
+                EXPECT_NEAR(it->corners[i], tag.corners[i], tolerance) << "tag " << tag.id << " corner " << i / 2;
+        }
+    }
+
+    std::shared_ptr<DetectorConfig> config;
+    const apriltag_family_t *tf;
+    std::shared_ptr<const Intrinsics> intrinsics;
+    std::vector<uint8_t> image;
+    std::vector<TagImage> tags;
+};
+
+TEST_F(TagDetectorTest, Detect)
+{
+    TagDetector detector(config);
+    for (const float decimate : {1.0f, 1.5f, 2.0f})
+    {
+        DetectorParameters parameters = default_parameters();
+        parameters.quad_decimate = decimate;
+        const Detections &detections = detect(detector, parameters);
+        expect_tags(detections);
+        EXPECT_TRUE(detections.bundles.empty());
+    }
+}
+
+TEST_F(TagDetectorTest, Pose)
+{
+    TagDetector detector(config);
+    for (const Detection &detection : detect(detector, default_parameters()).tags)
+    {
+        // a tag parallel to the image plane at the distance by its edge in
+        // pixels, with the z axis towards the camera
+        const std::array<double, 8> &corners = tag(detection.id).corners;
+        const double z = 500 * size / (corners[2] - corners[0]);
+        const double u = (corners[0] + corners[2]) / 2;
+        const double v = (corners[1] + corners[5]) / 2;
+        EXPECT_NEAR(detection.pose.translation.z(), z, 0.02 * z);
+        EXPECT_NEAR(detection.pose.translation.x(), (u - 320) * z / 500, 0.01);
+        EXPECT_NEAR(detection.pose.translation.y(), (v - 240) * z / 500, 0.01);
+        // the tilt of small tags is sensitive to the corners
+        EXPECT_LT(detection.pose.rotation.angularDistance(Eigen::Quaterniond(0, 1, 0, 0)), 0.15);
+        EXPECT_DOUBLE_EQ(detection.size, size);
+    }
+}
+
+TEST_F(TagDetectorTest, Tracking)
+{
+    config->configure([](Settings &settings) {
+        settings.tracking = true;
+        settings.tracking_interval = 10;
+    });
+    TagDetector detector(config);
+    detector.configure(default_parameters());
+    Tracking tracking(config->families);
+
+    // full-frame search, then only the regions around the tracked tags
+    for (int frame = 0; frame < 3; frame++)
+    {
+        Detections &detections = detector.detect("mono8", image.data(), width, height, width, *intrinsics, &tracking, frame * 33000000);
+        expect_tags(detections);
+        tracking.update(detections.tags, frame * 33000000, *config->settings());
+        EXPECT_EQ(tracking.frames_tracked, frame);
+        EXPECT_EQ(tracking.previous.size(), tags.size());
+    }
+    ASSERT_NE(tracking.find(tf, 42), nullptr);
+    EXPECT_TRUE(tracking.find(tf, 42)->previous);
+    EXPECT_EQ(tracking.find(tf, 1), nullptr);
+}
+
+TEST_F(TagDetectorTest, Conversion)
+{
+    // the same tags in a converted image
+    std::vector<uint8_t> rgb(image.size() * 3);
+    for (size_t i = 0; i < image.size(); i++)
+        std::fill_n(&rgb[3 * i], 3, image[i]);
+
+    TagDetector detector(config);
+    detector.configure(default_parameters());
+    expect_tags(detector.detect("rgb8", rgb.data(), width, height, 3 * width, *intrinsics));
+    EXPECT_EQ(detector.scratch(), image.size());
+    EXPECT_GT(detector.timings().conversion, 0);
+
+    // mono8 images are wrapped without the conversion buffer
+    expect_tags(detector.detect("mono8", image.data(), width, height, width, *intrinsics));
+    EXPECT_EQ(detector.scratch(), 0u);
+}
+
+TEST_F(TagDetectorTest, FrameNames)
+{
+    TagDetector detector(config);
+    std::vector<const std::string *> frames;
+    for (const Detection &detection : detect(detector, default_parameters()).tags)
+    {
+        ASSERT_NE(detection.frame, nullptr);
+        EXPECT_EQ(*detection.frame, "tag36h11:" + std::to_string(detection.id));
+        frames.push_back(detection.frame);
+    }
+
+    // the stored names are reused by the next frames
+    const Detections &detections = detect(detector, default_parameters());
+    ASSERT_EQ(detections.tags.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+        EXPECT_EQ(detections.tags[i].frame, frames[i]);
+}
+
+TEST(TagConfig, DefaultNames)
+{
+    const TagFamilies families({"36h11"});
+    const apriltag_family_t *tf = families.get().front();
+    const TagConfigs tags = tag_config(tf, {}, {}, {}, size);
+    ASSERT_EQ(tags.ids.size(), tf->ncodes);
+    ASSERT_EQ(tags.frames.size(), tf->ncodes);
+    EXPECT_EQ(tags.frames[tags.get(586).frame], "tag36h11:586");
+
+    // large families only store the configured ids, the detector names the
+    // other ids on their first detection
+    char name[] = "large";
+    apriltag_family_t large = {};
+    large.ncodes = 50000;
+    large.name = name;
+    const TagConfigs configured = tag_config(&large, {10, 30000}, {}, {0.1, 0.2}, size);
+    EXPECT_EQ(configured.ids.size(), 30001u);
+    EXPECT_TRUE(configured.frames.empty());
+    EXPECT_LT(configured.get(30000).frame, 0);
+    EXPECT_DOUBLE_EQ(configured.get(30000).size, 0.2);
+    EXPECT_DOUBLE_EQ(configured.get(40000).size, size);
+    EXPECT_TRUE(configured.get(40000).enabled);
+}
+
+TEST_F(TagDetectorTest, Timings)
+{
+    TagDetector detector(config);
+    for (const float decimate : {1.0f, 2.0f})
+    {
+        DetectorParameters parameters = default_parameters();
+        parameters.quad_decimate = decimate;
+        detect(detector, parameters);
+
+        // a VGA frame with a few tags is detected well within a second, the
+        // stages are part of the detection
+        const Timings &timings = detector.timings();
+        EXPECT_GT(timings.detection, 0);
+        EXPECT_LT(timings.detection, 1.0);
+        EXPECT_GE(timings.pose, 0);
+        EXPECT_LT(timings.pose, 0.1);
+        const double stages = std::accumulate(timings.stages.begin(), timings.stages.end(), 0.0, [](const double sum, const Stage &stage) { return sum + stage.duration; });
+        EXPECT_LE(stages, timings.detection * 1.05 + 1e-3);
+
+        // the library only stamps the decimation if it decimates
+        const bool decimated = std::any_of(timings.stages.begin(), timings.stages.end(), [](const Stage &stage) { return stage.name == "decimate"; });
+        EXPECT_EQ(decimated, decimate > 1);
+    }
+}
+
+TEST_F(TagDetectorTest, ConfiguredTags)
+{
+    config->tags.front() = tag_config(tf, {7, 42}, {"left", "right"}, {0.1, 0.2}, size);
+    TagDetector detector(config);
+
+    const Detections &detections = detect(detector, default_parameters());
+    ASSERT_EQ(detections.tags.size(), 2u);
+    for (const Detection &detection : detections.tags)
+    {
+        ASSERT_TRUE(detection.id == 7 || detection.id == 42);
+        ASSERT_NE(detection.frame, nullptr);
+        EXPECT_EQ(*detection.frame, detection.id == 7 ? "left" : "right");
+        EXPECT_DOUBLE_EQ(detection.size, detection.id == 7 ? 0.1 : 0.2);
+    }
+
+    EXPECT_THROW(tag_config(tf, {int64_t(tf->ncodes)}, {}, {}, size), std::runtime_error);
+    EXPECT_THROW(tag_config(tf, {1, 2}, {"one"}, {}, size), std::runtime_error);
+}
+
+TEST_F(TagDetectorTest, Pyramid)
+{
+    // a large tag covering several tiles and a small tag across the tiles
+    image.assign(size_t(width) * height, 255);
+    tags.clear();
+    tags.push_back(render(image, width, tf, 3, 300, 100, 30));
+    tags.push_back(render(image, width, tf, 11, 230, 20, 5));
+    tags.push_back(render(image, width, tf, 99, 30, 380, 4));
+
+    config->configure([](Settings &settings) {
+        settings.pyramid = true;
+        settings.pyramid_decimate = 4;
+        settings.pyramid_tile = 128;
+        settings.pyramid_overlap = 16;
+    });
+    TagDetector detector(config);
+    DetectorParameters parameters = default_parameters();
+    parameters.quad_decimate = 1;
+
+    // tags found by multiple passes or tiles are reported once
+    const Detections &detections = detect(detector, parameters);
+    expect_tags(detections);
+    std::set<int> ids;
+    for (const Detection &detection : detections.tags)
+        EXPECT_TRUE(ids.insert(detection.id).second) << "tag " << detection.id;
+}